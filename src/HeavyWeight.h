@@ -1,8 +1,8 @@
-#pragama once
+#pragma once
 
 struct SomeHeavyWeight
 {
     float floats[100];
     int   integers[100];
-    bool  true_or_false[200]
+    bool  true_or_false[200];
 };
@@ -0,0 +1,159 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+// Blocked Bloom filter, to turn away lookups for keys that aren't there before they pay for the
+// full binary search. A key's 8 bits all land in one 64 byte block (one bit in each of its eight
+// 64 bit words), so a check is one cache miss and no branches, where a classic Bloom filter is up
+// to 8 misses. At the default 16 bits per key the false positive rate is well under 1%.
+// Bloom filters can't forget, so erased keys leave their bits behind. That only costs false
+// positives, never a wrong answer, and the filter is rebuilt once a quarter of what it holds is stale.
+
+template<class Key, class Hash = std::hash<Key>>
+class blocked_bloom_filter
+{
+public:
+    static constexpr std::size_t default_bits_per_key = 16;
+
+    explicit blocked_bloom_filter(std::size_t expected = 0, std::size_t bits_per_key = default_bits_per_key)
+        : bits_per_key(bits_per_key)
+    {
+        reset(expected);
+    }
+
+    // empty, sized for expected keys
+    void reset(std::size_t expected)
+    {
+        const std::size_t wanted = std::max<std::size_t>(1, expected * bits_per_key / block_bits);
+        blocks.assign(std::bit_ceil(wanted), block{});
+        capacity = blocks.size() * block_bits / bits_per_key;
+    }
+
+    void insert(const Key &key) noexcept
+    {
+        const std::uint64_t h = mix(hasher(key));
+        block &b = blocks[h & (blocks.size() - 1)];
+        for (unsigned i = 0; i < words; ++i)
+            b.word[i] |= bit(h, i);
+    }
+
+    // false means certainly not present
+    bool may_contain(const Key &key) const noexcept
+    {
+        const std::uint64_t h = mix(hasher(key));
+        const block &b = blocks[h & (blocks.size() - 1)];
+        std::uint64_t missing = 0;
+        for (unsigned i = 0; i < words; ++i)
+            missing |= bit(h, i) & ~b.word[i];
+        return missing == 0;
+    }
+
+    // keys it was sized for, past that the false positive rate climbs
+    std::size_t planned_size() const noexcept { return capacity; }
+    std::size_t size_bytes() const noexcept { return blocks.size() * sizeof(block); }
+
+private:
+    static constexpr unsigned words = 8;
+    static constexpr std::size_t block_bits = 64 * words;
+
+    struct alignas(64) block
+    {
+        std::uint64_t word[words];
+    };
+
+    // std::hash of an integer is the integer, spread it over all 64 bits (murmur3 finaliser)
+    static std::uint64_t mix(std::uint64_t h) noexcept
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+    // the block is picked by the low bits, the bit in each word comes from the high 32 times a salt
+    static std::uint64_t bit(std::uint64_t h, unsigned i) noexcept
+    {
+        static constexpr std::uint32_t salt[words] = {0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+                                                       0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+        return std::uint64_t(1) << ((std::uint32_t(h >> 32) * salt[i]) >> 26);
+    }
+
+    std::vector<block> blocks;
+    std::size_t bits_per_key;
+    std::size_t capacity{0};
+    [[no_unique_address]] Hash hasher;
+};
+
+// Index decorator for indexed_sorted_vector: lookups go through Index as before, and find() asks
+// the filter first. Batch inserts add their keys to the filter, batch erases are counted as stale.
+template<class Index, class Key, class Hash = std::hash<Key>>
+class bloom_filtered
+{
+public:
+    bloom_filtered() = default;
+    explicit bloom_filtered(Index inner, std::size_t bits_per_key = blocked_bloom_filter<Key, Hash>::default_bits_per_key)
+        : inner(std::move(inner)), filter(0, bits_per_key) {}
+
+    template<class Container>
+    void rebuild(const Container &sorted)
+    {
+        inner.rebuild(sorted);
+        refill(sorted);
+    }
+    template<class Container>
+    void update(const Container &sorted, const Key &lo, const Key &hi)
+    {
+        if constexpr (requires { inner.update(sorted, lo, hi); })
+            inner.update(sorted, lo, hi);
+        else
+            inner.rebuild(sorted);
+    }
+    template<class Container>
+    void inserted(const Container &sorted, std::span<const Key> keys)
+    {
+        live = sorted.size();
+        if (live > filter.planned_size())
+            return refill(sorted);
+        for (const Key &key : keys)
+            filter.insert(key);
+    }
+    template<class Container>
+    void erased(const Container &sorted, std::size_t count)
+    {
+        live = sorted.size();
+        stale += count;
+        if (stale > (live + stale) / 4)
+            refill(sorted);
+    }
+
+    template<class Container>
+    std::size_t lower_bound(const Container &sorted, const Key &key) const { return inner.lower_bound(sorted, key); }
+    bool may_contain(const Key &key) const noexcept { return filter.may_contain(key); }
+
+    const Index &inner_index() const noexcept { return inner; }
+    const blocked_bloom_filter<Key, Hash> &bloom() const noexcept { return filter; }
+
+private:
+    template<class Container>
+    void refill(const Container &sorted)
+    {
+        // room to grow by half again before the next refill
+        filter.reset(sorted.size() + sorted.size() / 2);
+        for (const auto &entry : sorted)
+            filter.insert(entry.k);
+        live = sorted.size();
+        stale = 0;
+    }
+
+    Index inner;
+    blocked_bloom_filter<Key, Hash> filter;
+    std::size_t live{0};
+    std::size_t stale{0};
+};
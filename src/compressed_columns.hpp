@@ -0,0 +1,441 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "simd_lower_bound.hpp"
+#include "sorted_vector.hpp"
+// Key/value columns with the keys compressed, for very large tables of dense integer keys.
+// The keys are cut into blocks of about block_size. Each block stores its first key (the base) and
+// every key as a delta from it, bit packed at the width of its largest delta. Keys that go up by
+// one need 7 bits each in a block of 128, not 32 (or 64 with the Elem padding). The bases are also
+// kept in their own array (mins), which the lookup searches first. It is a 128th of the keys, so
+// it stays in cache. Then one block is searched in place: a branchless binary search on the packed
+// deltas, down to 16 of them, which are unpacked and counted with AVX2 (gather, variable shift,
+// mask, compare). That is the same scheme as simd_search, and needs no decode buffer.
+// The packed deltas of all the blocks are in one array, each block is an offset into it, a size
+// and a width (16 bytes per block). Values live with their block.
+// A batch update only decodes and re-encodes the blocks it touches, the other blocks' words are
+// copied into the new array as they are (about n / 8 bytes for dense keys, a memcpy) and their
+// values are moved. A block that grows past 2 * block_size is split, and one that shrinks below a
+// quarter of block_size is folded into the block before it.
+// Integer keys in ascending order only, the deltas are key differences.
+
+namespace compressed_detail
+{
+inline std::uint64_t load64(const std::uint32_t *p) noexcept
+{
+    std::uint64_t retval;
+    std::memcpy(&retval, p, sizeof(retval));
+    return retval;
+}
+
+// delta i of a block packed width bits each (width <= 32), or stored whole (width == 64).
+// Every delta is read as 64 bits from the word it starts in, so the words need one word of padding
+inline std::uint64_t get(const std::uint32_t *words, unsigned width, std::size_t i) noexcept
+{
+    if (width == 64)
+        return load64(words + 2 * i);
+    const std::size_t bit = i * width;
+    return (load64(words + (bit >> 5)) >> (bit & 31)) & ((std::uint64_t(1) << width) - 1);
+}
+
+inline std::vector<std::uint32_t> pack(const std::vector<std::uint64_t> &deltas, unsigned width)
+{
+    std::vector<std::uint32_t> retval;
+    if (width == 64)
+    {
+        retval.resize(2 * deltas.size());
+        if (!deltas.empty())
+            std::memcpy(retval.data(), deltas.data(), deltas.size() * sizeof(std::uint64_t));
+        return retval;
+    }
+    retval.assign(deltas.size() * width / 32 + 2, 0);
+    for (std::size_t i = 0; i < deltas.size(); ++i)
+    {
+        const std::size_t bit = i * width;
+        const std::uint64_t shifted = deltas[i] << (bit & 31);
+        retval[bit >> 5] |= std::uint32_t(shifted);
+        retval[(bit >> 5) + 1] |= std::uint32_t(shifted >> 32);
+    }
+    return retval;
+}
+
+// deltas [first, first + n) that are less than target
+inline std::size_t count_less_scalar(const std::uint32_t *words, unsigned width, std::size_t first, std::size_t n, std::uint64_t target) noexcept
+{
+    std::size_t retval = 0;
+    for (std::size_t i = first; i < first + n; ++i)
+        retval += get(words, width, i) < target;
+    return retval;
+}
+
+#ifdef SORTED_VECTOR_X86
+// deltas [first, first + 4) in 64 bit lanes. Precondition: width <= 32
+[[gnu::target("avx2")]] inline __m256i unpack4_avx2(const std::uint32_t *words, unsigned width, std::size_t first) noexcept
+{
+    const int w = int(width);
+    const __m128i bits = _mm_add_epi32(_mm_set1_epi32(int(first * width)), _mm_setr_epi32(0, w, 2 * w, 3 * w));
+    const __m128i word = _mm_srli_epi32(bits, 5);
+    const __m256i shift = _mm256_cvtepu32_epi64(_mm_and_si128(bits, _mm_set1_epi32(31)));
+    const __m256i raw = _mm256_i32gather_epi64(reinterpret_cast<const long long *>(words), word, 4);
+    const __m256i mask = _mm256_set1_epi64x(static_cast<long long>((std::uint64_t(1) << width) - 1));
+    return _mm256_and_si256(_mm256_srlv_epi64(raw, shift), mask);
+}
+
+// as count_less_scalar, for finish_width deltas. Precondition: width <= 32, target <= 2^32
+[[gnu::target("avx2")]] inline std::size_t count_less_avx2(const std::uint32_t *words, unsigned width, std::size_t first, std::uint64_t target) noexcept
+{
+    // deltas and target are under 2^63, so the signed compare is fine
+    const __m256i t = _mm256_set1_epi64x(static_cast<long long>(target));
+    unsigned mask = 0;
+    for (std::size_t i = 0; i < simd_search::finish_width; i += 4)
+        mask |= unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(t, unpack4_avx2(words, width, first + i))))) << i;
+    return __builtin_popcount(mask);
+}
+
+// all n deltas, plus base, to out. Precondition: width <= 32
+template<class Key>
+[[gnu::target("avx2")]] void unpack_avx2(const std::uint32_t *words, unsigned width, std::size_t n, Key base, Key *out) noexcept
+{
+    using U = std::make_unsigned_t<Key>;
+    const __m256i b = _mm256_set1_epi64x(static_cast<long long>(std::uint64_t(U(base))));
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        alignas(32) std::uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), _mm256_add_epi64(b, unpack4_avx2(words, width, i)));
+        for (int j = 0; j < 4; ++j)
+            out[i + j] = Key(U(lanes[j]));
+    }
+    for (; i < n; ++i)
+        out[i] = Key(U(U(base) + get(words, width, i)));
+}
+#endif
+} // compressed_detail
+
+template<class Key, class Value, class Compare = std::less<Key>>
+class compressed_sorted_columns
+{
+    static_assert(std::is_integral_v<Key> && simd_search::accelerated<Key, Compare>, "the deltas need integer keys in ascending order");
+    using unsigned_key = std::make_unsigned_t<Key>;
+
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = sorted_entry<Key, Value>;
+    using size_type = std::size_t;
+
+    // keys per block when built, blocks hold between a quarter of this and twice this
+    static constexpr size_type block_size = 128;
+
+    compressed_sorted_columns() = default;
+    // bulk construction, from unsorted entries
+    // if keys are duplicated, which of the duplicates is kept is unspecified
+    explicit compressed_sorted_columns(std::vector<value_type> unsorted)
+    {
+        sorted_detail::sort_entries(unsorted, comp);
+        std::vector<Key> keys;
+        std::vector<Value> column;
+        keys.reserve(unsorted.size());
+        column.reserve(unsorted.size());
+        for (auto &entry : unsorted)
+        {
+            if (!keys.empty() && !comp(keys.back(), entry.k))
+                continue;
+            keys.push_back(entry.k);
+            column.push_back(std::move(entry.v));
+        }
+        count = keys.size();
+        words.assign(padding_words, 0);
+        emit(keys, column, blocks, mins, values, words);
+        words.shrink_to_fit();
+        blocks.shrink_to_fit();
+        mins.shrink_to_fit();
+    }
+
+    size_type size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+    size_type block_count() const noexcept { return blocks.size(); }
+    // memory held for the keys: the packed words, the block descriptors and the block minimums
+    size_type key_bytes() const noexcept
+    {
+        return words.capacity() * sizeof(std::uint32_t) + blocks.capacity() * sizeof(block) + mins.capacity() * sizeof(Key);
+    }
+
+    // nullptr if not present
+    const Value *find(const Key &key) const
+    {
+        if (mins.empty() || comp(key, mins.front()))
+            return nullptr;
+        const size_type b = std::upper_bound(mins.begin(), mins.end(), key, comp) - mins.begin() - 1;
+        const block &blk = blocks[b];
+        const std::uint64_t target = delta(mins[b], key);
+        const size_type pos = lower_bound_in(words.data() + blk.offset, blk, target);
+        if (pos == blk.size || compressed_detail::get(words.data() + blk.offset, blk.width, pos) != target)
+            return nullptr;
+        return &values[b][pos];
+    }
+    bool contains(const Key &key) const { return find(key) != nullptr; }
+
+    // calls fn(key, value) for every element, in key order
+    template<class Fn>
+    void for_each(Fn &&fn) const
+    {
+        std::vector<Key> keys;
+        for (size_type b = 0; b < blocks.size(); ++b)
+        {
+            keys.clear();
+            decode(words, blocks[b], mins[b], keys);
+            for (size_type i = 0; i < keys.size(); ++i)
+                fn(keys[i], values[b][i]);
+        }
+    }
+
+    /*
+    batch_insert:
+     keys that are already present are not replaced (same as std::map::insert)
+     the batch is sorted, then each block that gets part of it is decoded, merged and re-encoded
+    */
+    void batch_insert(std::vector<value_type> selection)
+    {
+        sorted_detail::sort_entries(selection, comp);
+        selection.erase(std::unique(selection.begin(), selection.end(),
+                                    [this](const value_type &a, const value_type &b) { return !comp(a.k, b.k); }),
+                        selection.end());
+        if (blocks.empty())
+        {
+            *this = compressed_sorted_columns{std::move(selection)};
+            return;
+        }
+        const auto key_of = [](const value_type &entry) -> const Key & { return entry.k; };
+        update_blocks(selection.begin(), selection.end(), key_of, [this](std::vector<Key> &keys, std::vector<Value> &column, auto first, auto last) {
+            std::vector<Key> merged_keys;
+            std::vector<Value> merged_column;
+            merged_keys.reserve(keys.size() + (last - first));
+            merged_column.reserve(keys.size() + (last - first));
+            size_type i = 0;
+            for (auto it = first; it != last; ++it)
+            {
+                for (; i < keys.size() && comp(keys[i], it->k); ++i)
+                {
+                    merged_keys.push_back(keys[i]);
+                    merged_column.push_back(std::move(column[i]));
+                }
+                if (i < keys.size() && !comp(it->k, keys[i]))
+                    continue;
+                merged_keys.push_back(it->k);
+                merged_column.push_back(std::move(it->v));
+                ++count;
+            }
+            for (; i < keys.size(); ++i)
+            {
+                merged_keys.push_back(keys[i]);
+                merged_column.push_back(std::move(column[i]));
+            }
+            keys = std::move(merged_keys);
+            column = std::move(merged_column);
+        });
+    }
+
+    /*
+    batch_erase:
+     keys that aren't present are ignored. returns the number of elements removed
+     only the blocks holding a key of the batch are re-encoded
+    */
+    size_type batch_erase(std::vector<Key> selection)
+    {
+        std::sort(selection.begin(), selection.end(), comp);
+        const size_type before = count;
+        const auto key_of = [](const Key &key) -> const Key & { return key; };
+        update_blocks(selection.begin(), selection.end(), key_of, [this](std::vector<Key> &keys, std::vector<Value> &column, auto first, auto last) {
+            size_type out = 0;
+            for (size_type i = 0; i < keys.size(); ++i)
+            {
+                first = sorted_detail::gallop_lower_bound(first, last, keys[i], comp);
+                if (first != last && !comp(keys[i], *first))
+                    continue;
+                if (out != i)
+                {
+                    keys[out] = keys[i];
+                    column[out] = std::move(column[i]);
+                }
+                ++out;
+            }
+            count -= keys.size() - out;
+            keys.resize(out);
+            column.resize(out);
+        });
+        return before - count;
+    }
+
+private:
+    // where a block's deltas are in words
+    struct block
+    {
+        std::uint64_t offset;
+        std::uint32_t size;
+        std::uint32_t width; // 0 to 32, or 64 for deltas stored whole
+    };
+
+    // every delta is read as 64 bits from the word it starts in, the last block's can run 2 words on
+    static constexpr size_type padding_words = 2;
+
+    static size_type packed_words(size_type n, unsigned width) noexcept
+    {
+        return width == 64 ? 2 * n : (n * width + 31) / 32;
+    }
+
+    static std::uint64_t delta(const Key &base, const Key &key) noexcept
+    {
+        return std::uint64_t(unsigned_key(unsigned_key(key) - unsigned_key(base)));
+    }
+
+    // same position std::lower_bound would give on the block's deltas
+    static size_type lower_bound_in(const std::uint32_t *packed, const block &blk, std::uint64_t target) noexcept
+    {
+        const size_type n = blk.size;
+        // every packed delta is under 2^32, so anything bigger counts them all
+        if (blk.width != 64)
+            target = std::min<std::uint64_t>(target, std::uint64_t(1) << 32);
+        if (n < simd_search::finish_width)
+            return compressed_detail::count_less_scalar(packed, blk.width, 0, n, target);
+        size_type base = 0;
+        size_type len = n;
+        while (len > simd_search::finish_width)
+        {
+            const size_type half = len / 2;
+            base = compressed_detail::get(packed, blk.width, base + half) < target ? base + half : base;
+            len -= half;
+        }
+        const size_type window = std::min(base, n - simd_search::finish_width);
+#ifdef SORTED_VECTOR_X86
+        if (blk.width != 64 && simd_search::best_level() == simd_search::level::avx2)
+            return window + compressed_detail::count_less_avx2(packed, blk.width, window, target);
+#endif
+        return window + compressed_detail::count_less_scalar(packed, blk.width, window, simd_search::finish_width, target);
+    }
+
+    // append the keys of blk, packed in all_words, to keys
+    static void decode(const std::vector<std::uint32_t> &all_words, const block &blk, const Key &base, std::vector<Key> &keys)
+    {
+        const std::uint32_t *packed = all_words.data() + blk.offset;
+        const size_type first = keys.size();
+        keys.resize(first + blk.size);
+#ifdef SORTED_VECTOR_X86
+        if (blk.width != 64 && simd_search::best_level() == simd_search::level::avx2)
+            return compressed_detail::unpack_avx2(packed, blk.width, blk.size, base, keys.data() + first);
+#endif
+        for (size_type i = 0; i < blk.size; ++i)
+            keys[first + i] = Key(unsigned_key(unsigned_key(base) + compressed_detail::get(packed, blk.width, i)));
+    }
+
+    // append packed[0, n) to out_words, which ends in padding_words of zeros, and still does after
+    static std::uint64_t append_words(std::vector<std::uint32_t> &out_words, const std::uint32_t *packed, size_type n)
+    {
+        const std::uint64_t retval = out_words.size() - padding_words;
+        out_words.resize(retval);
+        out_words.insert(out_words.end(), packed, packed + n);
+        out_words.resize(out_words.size() + padding_words, 0);
+        return retval;
+    }
+
+    // sorted keys and their values as blocks on the end of out. One block up to 2 * block_size,
+    // past that evenly sized blocks of about block_size
+    static void emit(const std::vector<Key> &keys, std::vector<Value> &column, std::vector<block> &out, std::vector<Key> &out_mins,
+                     std::vector<std::vector<Value>> &out_values, std::vector<std::uint32_t> &out_words)
+    {
+        const size_type n = keys.size();
+        if (n == 0)
+            return;
+        const size_type pieces = n <= 2 * block_size ? 1 : (n + block_size - 1) / block_size;
+        std::vector<std::uint64_t> deltas;
+        for (size_type i = 0; i < pieces; ++i)
+        {
+            const size_type first = n * i / pieces;
+            const size_type last = n * (i + 1) / pieces;
+            deltas.resize(last - first);
+            for (size_type k = first; k < last; ++k)
+                deltas[k - first] = delta(keys[first], keys[k]);
+            const unsigned bits = unsigned(std::bit_width(deltas.back()));
+            const unsigned width = bits <= 32 ? bits : 64;
+            const auto packed = compressed_detail::pack(deltas, width);
+            out.push_back({append_words(out_words, packed.data(), packed_words(last - first, width)), std::uint32_t(last - first), width});
+            out_mins.push_back(keys[first]);
+            out_values.emplace_back(std::make_move_iterator(column.begin() + first), std::make_move_iterator(column.begin() + last));
+        }
+    }
+
+    // the batch [first, last) is sorted by key_of. Each block with part of it is decoded and passed
+    // to edit(keys, values, part_first, part_last), and the result re-encoded. The words of the
+    // other blocks are copied as they are, into a new words array
+    template<class It, class KeyOf, class Edit>
+    void update_blocks(It first, const It last, KeyOf key_of, Edit edit)
+    {
+        std::vector<block> out;
+        std::vector<Key> out_mins;
+        std::vector<std::vector<Value>> out_values;
+        std::vector<std::uint32_t> out_words(padding_words, 0);
+        out.reserve(blocks.size());
+        out_mins.reserve(blocks.size());
+        out_values.reserve(blocks.size());
+        out_words.reserve(words.size());
+        std::vector<Key> keys;
+        std::vector<Value> column;
+        for (size_type b = 0; b < blocks.size(); ++b)
+        {
+            // keys before the first block go to the first block, keys past the last to the last
+            const It part_last = b + 1 < blocks.size()
+                ? std::lower_bound(first, last, mins[b + 1], [&](const auto &e, const Key &k) { return comp(key_of(e), k); })
+                : last;
+            if (first == part_last)
+            {
+                block moved = blocks[b];
+                moved.offset = append_words(out_words, words.data() + blocks[b].offset, packed_words(moved.size, moved.width));
+                out.push_back(moved);
+                out_mins.push_back(mins[b]);
+                out_values.push_back(std::move(values[b]));
+                continue;
+            }
+            keys.clear();
+            decode(words, blocks[b], mins[b], keys);
+            column = std::move(values[b]);
+            edit(keys, column, first, part_last);
+            first = part_last;
+            if (keys.size() < block_size / 4 && !out.empty())
+            {
+                // too small to stand alone, fold it into the block before (the last words written)
+                std::vector<Key> prev_keys;
+                decode(out_words, out.back(), out_mins.back(), prev_keys);
+                std::vector<Value> prev_column = std::move(out_values.back());
+                out_words.resize(out.back().offset);
+                out_words.resize(out_words.size() + padding_words, 0);
+                out.pop_back();
+                out_mins.pop_back();
+                out_values.pop_back();
+                prev_keys.insert(prev_keys.end(), keys.begin(), keys.end());
+                prev_column.insert(prev_column.end(), std::make_move_iterator(column.begin()), std::make_move_iterator(column.end()));
+                keys = std::move(prev_keys);
+                column = std::move(prev_column);
+            }
+            emit(keys, column, out, out_mins, out_values, out_words);
+        }
+        blocks = std::move(out);
+        mins = std::move(out_mins);
+        values = std::move(out_values);
+        words = std::move(out_words);
+    }
+
+    std::vector<std::uint32_t> words; // every block's packed deltas, back to back, then padding_words
+    std::vector<block> blocks;
+    std::vector<Key> mins; // first key of each block, searched before the block
+    std::vector<std::vector<Value>> values; // each block's values
+    size_type count{0};
+    [[no_unique_address]] Compare comp;
+};
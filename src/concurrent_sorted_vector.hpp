@@ -0,0 +1,317 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+// Single writer, many readers, no reader locks.
+// The table is a list of chunks (small sorted_vectors) held by an immutable version. A reader pins
+// the current version and searches it, nothing it can see ever changes. The writer builds the next
+// version copy-on-write: only the chunks a batch touches are copied and modified, the rest are
+// shared with the old version, then the new version is published with one atomic store.
+//
+// Reclamation is epoch based. Each reader has a slot, and announces the global epoch in it while it
+// holds a snapshot. A reader can hold several snapshots at once: the slot keeps the epoch of the
+// oldest, and goes idle when the last one is dropped. A replaced version is retired with the epoch it was replaced in, and the epoch
+// moves on. It is freed once every announced epoch is later than that, as any reader that started
+// after the epoch moved on can only have seen a newer version.
+// Writers are serialised by a mutex, it is never taken by readers.
+
+template<class Key, class Value, class Compare = std::less<Key>>
+class concurrent_sorted_vector
+{
+public:
+    using chunk_type = sorted_vector<Key, Value, Compare>;
+    using key_type = Key;
+    using value_type = typename chunk_type::value_type;
+    using size_type = typename chunk_type::size_type;
+
+    static constexpr size_type default_chunk_size = 4096;
+    static constexpr size_type max_readers = 64;
+
+private:
+    struct version
+    {
+        std::vector<std::shared_ptr<const chunk_type>> chunks;
+        std::vector<Key> firsts; // first key of each chunk
+        size_type size{0};
+
+        // index of the chunk that would hold key
+        size_type chunk_for(const Key &key, const Compare &comp) const
+        {
+            const auto after = std::upper_bound(firsts.begin(), firsts.end(), key, comp);
+            return after == firsts.begin() ? 0 : size_type(after - firsts.begin() - 1);
+        }
+    };
+
+    static constexpr std::uint64_t idle = std::numeric_limits<std::uint64_t>::max();
+
+    struct alignas(64) reader_slot
+    {
+        std::atomic<bool> in_use{false};
+        std::atomic<std::uint64_t> epoch{idle};
+        unsigned snapshots{0}; // live snapshots, only touched by the owning thread
+    };
+
+public:
+    // An immutable view of the table, valid for as long as it lives. Cheap, take one per query
+    // (or per batch of queries), holding one for long holds back reclamation.
+    class snapshot
+    {
+    public:
+        snapshot(const snapshot &) = delete;
+        snapshot &operator=(const snapshot &) = delete;
+        ~snapshot()
+        {
+            if (--slot->snapshots == 0)
+                slot->epoch.store(idle, std::memory_order_release);
+        }
+
+        size_type size() const noexcept { return v->size; }
+        bool empty() const noexcept { return size() == 0; }
+
+        // nullptr if not present
+        const value_type *find(const Key &key) const
+        {
+            if (v->chunks.empty())
+                return nullptr;
+            const chunk_type &chunk = *v->chunks[v->chunk_for(key, comp)];
+            const auto found = chunk.find(key);
+            return found == chunk.end() ? nullptr : &*found;
+        }
+        bool contains(const Key &key) const { return find(key) != nullptr; }
+
+        // calls fn(entry) for every entry with a key in [lo, hi), in order
+        template<class Fn>
+        void scan(const Key &lo, const Key &hi, Fn &&fn) const
+        {
+            for (size_type c = v->chunks.empty() ? 0 : v->chunk_for(lo, comp); c < v->chunks.size(); ++c)
+                for (auto entry = v->chunks[c]->lower_bound(lo); entry != v->chunks[c]->end(); ++entry)
+                {
+                    if (!comp(entry->k, hi))
+                        return;
+                    fn(*entry);
+                }
+        }
+
+    private:
+        friend class concurrent_sorted_vector;
+        snapshot(reader_slot *slot, const version *v, const Compare &comp) : slot(slot), v(v), comp(comp) {}
+
+        reader_slot *slot;
+        const version *v;
+        [[no_unique_address]] Compare comp;
+    };
+
+    // A registered reader thread, owns an epoch slot. One per thread, not shared.
+    // Its snapshots must be taken and dropped on that thread, any number can be alive at once.
+    class reader
+    {
+    public:
+        explicit reader(const concurrent_sorted_vector &table) : table(&table), slot(table.acquire_slot()) {}
+        ~reader() { slot->in_use.store(false, std::memory_order_release); }
+        reader(const reader &) = delete;
+        reader &operator=(const reader &) = delete;
+
+        snapshot read() const
+        {
+            // announce first, then load: the writer can't free what we load after announcing.
+            // With a snapshot already alive the older epoch stays announced, it covers this one too
+            if (slot->snapshots++ == 0)
+                slot->epoch.store(table->epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return snapshot{slot, table->current.load(std::memory_order_seq_cst), table->comp};
+        }
+
+    private:
+        const concurrent_sorted_vector *table;
+        reader_slot *slot;
+    };
+
+    explicit concurrent_sorted_vector(chunk_type initial = {}, size_type chunk_size = default_chunk_size)
+        : chunk_size(chunk_size), comp(initial.key_comp())
+    {
+        auto v = std::make_unique<version>();
+        auto entries = std::move(initial).extract();
+        for (size_type first = 0; first < entries.size(); first += chunk_size)
+        {
+            const size_type last = std::min(first + chunk_size, size_type(entries.size()));
+            typename chunk_type::container_type piece(std::make_move_iterator(entries.begin() + first),
+                                                      std::make_move_iterator(entries.begin() + last));
+            push_chunk(*v, std::make_shared<const chunk_type>(sorted_unique, std::move(piece), comp));
+        }
+        current.store(v.release());
+    }
+    ~concurrent_sorted_vector()
+    {
+        for (auto &old : retired)
+            delete old.v;
+        delete current.load();
+    }
+    concurrent_sorted_vector(const concurrent_sorted_vector &) = delete;
+    concurrent_sorted_vector &operator=(const concurrent_sorted_vector &) = delete;
+
+    // keys that are already present are not replaced. Only the chunks the batch lands in are copied
+    void batch_insert(std::vector<value_type> selection)
+    {
+        std::lock_guard lock(writer);
+        const chunk_type batch{std::move(selection), comp};
+        const version &old = *current.load();
+        auto next = std::make_unique<version>();
+        auto from = batch.begin();
+        for (size_type c = 0; c < old.chunks.size() || (c == 0 && from != batch.end()); ++c)
+        {
+            // the first chunk also takes keys before it, the last one the keys after it
+            const auto to = c + 1 < old.chunks.size()
+                ? std::lower_bound(from, batch.end(), old.firsts[c + 1], batch.value_comp())
+                : batch.end();
+            if (from == to)
+            {
+                push_chunk(*next, old.chunks[c]);
+                continue;
+            }
+            auto updated = c < old.chunks.size() ? chunk_type(*old.chunks[c]) : chunk_type(comp);
+            updated.batch_insert(std::vector<value_type>(from, to));
+            from = to;
+            push_split(*next, std::move(updated));
+        }
+        publish(std::move(next));
+    }
+
+    // returns the number of elements removed
+    size_type batch_erase(std::vector<Key> selection)
+    {
+        std::lock_guard lock(writer);
+        std::sort(selection.begin(), selection.end(), comp);
+        const version &old = *current.load();
+        auto next = std::make_unique<version>();
+        size_type retval = 0;
+        auto from = selection.begin();
+        for (size_type c = 0; c < old.chunks.size(); ++c)
+        {
+            const auto to = c + 1 < old.chunks.size()
+                ? std::lower_bound(from, selection.end(), old.firsts[c + 1], comp)
+                : selection.end();
+            if (from == to)
+            {
+                push_chunk(*next, old.chunks[c]);
+                continue;
+            }
+            chunk_type updated(*old.chunks[c]);
+            const size_type erased = updated.batch_erase_sorted(std::span<const Key>(&*from, to - from));
+            from = to;
+            if (erased == 0)
+            {
+                push_chunk(*next, old.chunks[c]);
+                continue;
+            }
+            retval += erased;
+            if (!updated.empty())
+                push_merged(*next, std::move(updated));
+        }
+        if (retval)
+            publish(std::move(next));
+        return retval;
+    }
+
+    // free the retired versions no reader can still see. Updates do this too
+    void collect()
+    {
+        std::lock_guard lock(writer);
+        reclaim();
+    }
+    // versions waiting for readers to move on
+    size_type retired_versions() const
+    {
+        std::lock_guard lock(writer);
+        return retired.size();
+    }
+
+private:
+    struct retired_version
+    {
+        const version *v;
+        std::uint64_t epoch;
+    };
+
+    reader_slot *acquire_slot() const
+    {
+        for (auto &slot : slots)
+            if (bool expected = false; slot.in_use.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return &slot;
+        throw std::runtime_error("concurrent_sorted_vector: too many readers");
+    }
+
+    static void push_chunk(version &v, std::shared_ptr<const chunk_type> chunk)
+    {
+        v.firsts.push_back(chunk->begin()->k);
+        v.size += chunk->size();
+        v.chunks.push_back(std::move(chunk));
+    }
+
+    // chunks that grew past twice the chunk size are cut back to chunk size pieces
+    void push_split(version &v, chunk_type chunk)
+    {
+        if (chunk.size() <= 2 * chunk_size)
+            return push_chunk(v, std::make_shared<const chunk_type>(std::move(chunk)));
+        auto entries = std::move(chunk).extract();
+        for (size_type first = 0; first < entries.size(); first += chunk_size)
+        {
+            const size_type last = std::min(first + chunk_size, size_type(entries.size()));
+            typename chunk_type::container_type piece(std::make_move_iterator(entries.begin() + first),
+                                                      std::make_move_iterator(entries.begin() + last));
+            push_chunk(v, std::make_shared<const chunk_type>(sorted_unique, std::move(piece), comp));
+        }
+    }
+
+    // chunks that shrank below a quarter are folded into the previous one, if they fit
+    void push_merged(version &v, chunk_type chunk)
+    {
+        if (chunk.size() >= chunk_size / 4 || v.chunks.empty() || v.chunks.back()->size() + chunk.size() > chunk_size)
+            return push_chunk(v, std::make_shared<const chunk_type>(std::move(chunk)));
+        auto entries = chunk_type(*v.chunks.back()).extract();
+        for (auto &entry : std::move(chunk).extract())
+            entries.push_back(std::move(entry));
+        v.size -= v.chunks.back()->size();
+        v.chunks.pop_back();
+        v.firsts.pop_back();
+        push_chunk(v, std::make_shared<const chunk_type>(sorted_unique, std::move(entries), comp));
+    }
+
+    void publish(std::unique_ptr<version> next)
+    {
+        const version *old = current.exchange(next.release(), std::memory_order_seq_cst);
+        retired.push_back({old, epoch.fetch_add(1, std::memory_order_seq_cst)});
+        reclaim();
+    }
+
+    void reclaim()
+    {
+        std::uint64_t oldest = idle;
+        for (const auto &slot : slots)
+            oldest = std::min(oldest, slot.epoch.load(std::memory_order_seq_cst));
+        const auto freed = std::remove_if(retired.begin(), retired.end(), [oldest](const retired_version &old) {
+            if (old.epoch >= oldest)
+                return false;
+            delete old.v;
+            return true;
+        });
+        retired.erase(freed, retired.end());
+    }
+
+    size_type chunk_size;
+    [[no_unique_address]] Compare comp;
+    std::atomic<const version *> current{nullptr};
+    std::atomic<std::uint64_t> epoch{0};
+    mutable reader_slot slots[max_readers];
+    mutable std::mutex writer;
+    std::vector<retired_version> retired; // writer only
+};
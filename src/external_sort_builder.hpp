@@ -0,0 +1,241 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "sorted_vector.hpp"
+#include "mapped_sorted_vector.hpp"
+// Bulk build for tables bigger than memory. Records are added in any order and buffered until the
+// buffer reaches the memory budget, then the buffer is sorted and spilled to a temporary file as a
+// sorted run. finish() k-way merges the runs (a heap of run readers) into the mapped file format,
+// or into an in-memory sorted_vector if the result does fit.
+// If there are more runs than max_merge_width, the oldest ones are merged into one bigger run first,
+// so the merge never has more than max_merge_width files open.
+// The budget covers the buffered records and the sort's scratch buffer, the merge only needs a
+// stream buffer per run. As with the sorted_vector constructor, one record per key survives,
+// which one is unspecified.
+// Values are strings (anything that converts to std::string_view can be added).
+
+template<class Key, class Compare = std::less<Key>>
+class external_sort_builder
+{
+public:
+    using key_type = Key;
+    using value_type = sorted_entry<Key, std::string>;
+    using result_type = sorted_vector<Key, std::string, Compare>;
+    using size_type = std::size_t;
+
+    static constexpr size_type default_memory_budget = size_type(64) << 20;
+    static constexpr size_type max_merge_width = 128;
+
+    explicit external_sort_builder(size_type memory_budget = default_memory_budget,
+                                   std::filesystem::path temp_dir = std::filesystem::temp_directory_path(),
+                                   const Compare &comp = Compare())
+        : memory_budget(memory_budget), temp_dir(std::move(temp_dir)), comp(comp)
+    {
+        static_assert(std::is_trivially_copyable_v<Key>, "keys are spilled as raw bytes");
+    }
+    ~external_sort_builder()
+    {
+        for (const auto &run : runs)
+            std::filesystem::remove(run);
+    }
+    external_sort_builder(const external_sort_builder &) = delete;
+    external_sort_builder &operator=(const external_sort_builder &) = delete;
+
+    void add(value_type record)
+    {
+        // each record costs its entry twice (the buffer and the sort's scratch) plus its bytes
+        used += 2 * sizeof(value_type) + record.v.size();
+        buffer.push_back(std::move(record));
+        if (used >= memory_budget)
+            spill();
+    }
+    void add(const Key &key, std::string_view value) { add(value_type{key, std::string(value)}); }
+
+    // sorted runs written to disk so far
+    size_type run_count() const noexcept { return runs.size(); }
+
+    // everything added, as a file in the mapped_sorted_vector format
+    void finish(const std::string &path, bool with_index = true)
+    {
+        mapped_writer<Key> writer(path, with_index);
+        merge_all([&writer](value_type &&record) { writer.append(record.k, record.v); });
+        writer.finish();
+    }
+    // everything added, in memory
+    result_type finish()
+    {
+        typename result_type::container_type merged;
+        merge_all([&merged](value_type &&record) { merged.push_back(std::move(record)); });
+        return result_type{sorted_unique, std::move(merged), comp};
+    }
+
+private:
+    // reads back one spilled run, a record at a time
+    struct run_reader
+    {
+        explicit run_reader(const std::filesystem::path &path) : path(path), in(path, std::ios::binary)
+        {
+            if (!in)
+                throw std::runtime_error("can't open " + path.string());
+        }
+        // false at the end of the run. Only a clean end, before a key, counts: anything cut short
+        // after that is a damaged run, and dropping its records would quietly lose data
+        bool next()
+        {
+            if (!in.read(reinterpret_cast<char *>(&current.k), sizeof(Key)))
+            {
+                if (in.gcount() == 0 && in.eof())
+                    return false;
+                throw std::runtime_error("truncated run " + path.string());
+            }
+            std::uint64_t length;
+            if (!in.read(reinterpret_cast<char *>(&length), sizeof(length)))
+                throw std::runtime_error("truncated run " + path.string());
+            current.v.resize(length);
+            if (!in.read(current.v.data(), std::streamsize(length)))
+                throw std::runtime_error("truncated run " + path.string());
+            return true;
+        }
+        std::filesystem::path path;
+        std::ifstream in;
+        value_type current;
+    };
+
+    // appends records to a new run file
+    struct run_writer
+    {
+        explicit run_writer(const std::filesystem::path &path) : out(path, std::ios::binary | std::ios::trunc)
+        {
+            if (!out)
+                throw std::runtime_error("can't create " + path.string());
+        }
+        void write(const value_type &record)
+        {
+            const std::uint64_t length = record.v.size();
+            out.write(reinterpret_cast<const char *>(&record.k), sizeof(Key));
+            out.write(reinterpret_cast<const char *>(&length), sizeof(length));
+            out.write(record.v.data(), std::streamsize(length));
+        }
+        std::ofstream out;
+    };
+
+    bool equal(const Key &a, const Key &b) const { return !comp(a, b) && !comp(b, a); }
+
+    std::filesystem::path next_run_path()
+    {
+        static std::atomic<unsigned> unique{0};
+        return temp_dir / ("sorted_run_" + std::to_string(::getpid()) + "_" + std::to_string(unique++) + ".tmp");
+    }
+
+    void spill()
+    {
+        if (buffer.empty())
+            return;
+        sorted_detail::sort_entries(buffer, comp, &scratch);
+        auto path = next_run_path();
+        {
+            run_writer run(path);
+            for (auto record = buffer.begin(); record != buffer.end(); ++record)
+                if (record == buffer.begin() || !equal(record[-1].k, record->k))
+                    run.write(*record);
+            if (!run.out.flush())
+                throw std::runtime_error("failed writing " + path.string());
+        }
+        runs.push_back(std::move(path));
+        buffer.clear();
+        used = 0;
+    }
+
+    // k-way merge of runs [first, last), calling emit once per distinct key in order
+    template<class Emit>
+    void merge(std::size_t first, std::size_t last, Emit &&emit)
+    {
+        std::vector<std::unique_ptr<run_reader>> readers;
+        const auto later = [this, &readers](std::size_t a, std::size_t b) {
+            return comp(readers[b]->current.k, readers[a]->current.k);
+        };
+        std::priority_queue<std::size_t, std::vector<std::size_t>, decltype(later)> heads(later);
+        for (auto run = first; run != last; ++run)
+        {
+            readers.push_back(std::make_unique<run_reader>(runs[run]));
+            if (readers.back()->next())
+                heads.push(readers.size() - 1);
+        }
+        bool any = false;
+        Key previous{};
+        while (!heads.empty())
+        {
+            const std::size_t top = heads.top();
+            heads.pop();
+            auto &record = readers[top]->current;
+            if (!any || !equal(previous, record.k))
+            {
+                any = true;
+                previous = record.k;
+                emit(std::move(record));
+            }
+            if (readers[top]->next())
+                heads.push(top);
+        }
+    }
+
+    template<class Emit>
+    void merge_all(Emit &&emit)
+    {
+        // everything fit in the budget, no files needed
+        if (runs.empty())
+        {
+            sorted_detail::sort_entries(buffer, comp, &scratch);
+            for (auto record = buffer.begin(); record != buffer.end(); ++record)
+                if (record == buffer.begin() || !equal(record[-1].k, record->k))
+                    emit(std::move(*record));
+            buffer.clear();
+            used = 0;
+            return;
+        }
+        spill();
+        buffer.shrink_to_fit();
+        scratch = {};
+        while (runs.size() > max_merge_width)
+        {
+            auto path = next_run_path();
+            {
+                run_writer run(path);
+                merge(0, max_merge_width, [&run](value_type &&record) { run.write(record); });
+                if (!run.out.flush())
+                    throw std::runtime_error("failed writing " + path.string());
+            }
+            for (std::size_t i = 0; i < max_merge_width; ++i)
+                std::filesystem::remove(runs[i]);
+            runs.erase(runs.begin(), runs.begin() + max_merge_width);
+            runs.push_back(std::move(path));
+        }
+        merge(0, runs.size(), emit);
+        for (const auto &run : runs)
+            std::filesystem::remove(run);
+        runs.clear();
+    }
+
+    size_type memory_budget;
+    std::filesystem::path temp_dir;
+    [[no_unique_address]] Compare comp;
+    std::vector<value_type> buffer;
+    std::vector<value_type> scratch; // for the radix sort, reused between spills
+    size_type used{0};
+    std::vector<std::filesystem::path> runs;
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+// Search index for a sorted_vector, with the keys copied out in Eytzinger (breadth first) order.
+// A plain binary search over 16M elements touches ~24 cache lines, each one a miss, and each
+// probe depends on the last so they can't overlap. In Eytzinger order the first few levels of the
+// search tree share a handful of cache lines that stay hot, and the 16 (for 4 byte keys)
+// grand-grand-children of a node are contiguous, so they can be prefetched 4 levels ahead.
+// The index is a copy, so it must be rebuilt after the vector changes (see indexed_sorted_vector).
+
+template<class Key, class Compare = std::less<Key>, class Rank = std::uint32_t>
+class eytzinger_index
+{
+public:
+    eytzinger_index() = default;
+    template<class SortedVector>
+    explicit eytzinger_index(const SortedVector &sorted, const Compare &comp = Compare())
+        : comp(comp)
+    {
+        rebuild(sorted);
+    }
+
+    template<class SortedVector>
+    void rebuild(const SortedVector &sorted)
+    {
+        n = sorted.size();
+        // slot 0 is unused, the root is 1, children of i are 2i and 2i+1
+        keys.resize(n + 1);
+        ranks.resize(n + 1);
+        auto src = sorted.begin();
+        Rank rank = 0;
+        fill(1, src, rank);
+    }
+
+    std::size_t size() const noexcept { return n; }
+
+    // same position std::lower_bound would give on the sorted vector (size() if none)
+    template<class SortedVector>
+    std::size_t lower_bound(const SortedVector &, const Key &key) const { return lower_bound(key); }
+
+    std::size_t lower_bound(const Key &key) const
+    {
+        const Key *base = keys.data();
+        std::size_t k = 1;
+        while (k <= n)
+        {
+            // the 16 descendants 4 levels down are adjacent, so one prefetch covers them all
+            __builtin_prefetch(base + std::min(k * prefetch_stride, n));
+            k = 2 * k + comp(base[k], key);
+        }
+        // we went right (key bigger) at every level below the answer, strip those moves off
+        k >>= __builtin_ffsll(~k);
+        return k == 0 ? n : ranks[k];
+    }
+
+private:
+    static constexpr std::size_t prefetch_stride = std::max<std::size_t>(1, 64 / sizeof(Key));
+
+    // in-order walk of the implicit tree, handing out the sorted keys in order
+    template<class It>
+    void fill(std::size_t k, It &src, Rank &rank)
+    {
+        if (k > n)
+            return;
+        fill(2 * k, src, rank);
+        keys[k] = src->k;
+        ranks[k] = rank++;
+        ++src;
+        fill(2 * k + 1, src, rank);
+    }
+
+    std::vector<Key> keys;
+    std::vector<Rank> ranks;
+    std::size_t n{0};
+    [[no_unique_address]] Compare comp;
+};
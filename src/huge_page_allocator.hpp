@@ -0,0 +1,102 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+#include <sys/mman.h>
+// Allocator for big sorted vectors, for the Allocator parameter of sorted_vector.
+// At 16M entries a vector is hundreds of MB, and with 4KB pages a binary search over it takes a TLB
+// miss (a page walk) on most probes, on top of the cache miss. With 2MB pages the whole vector
+// needs a few hundred TLB entries instead of a hundred thousand, and the walks mostly go away.
+//
+// Allocations of huge_page_size or more are mmap'ed 2MB aligned and advised for transparent huge
+// pages (madvise MADV_HUGEPAGE), which works whether THP is set to "always" or "madvise". If the
+// kernel has THP off (or has no THP) the advice is ignored and the memory is normal pages, nothing
+// else changes. Smaller allocations aren't worth a page, and go to std::allocator.
+//
+// For a bulk build, reserve with reserve_prefaulted(): the new pages are faulted in straight away,
+// in one tight loop, instead of one at a time in the middle of the fill, and with huge pages it is
+// one fault per 2MB. Plain allocations (vector growth) don't pre-fault, the elements are about to
+// be written anyway.
+
+inline constexpr std::size_t huge_page_size = std::size_t(2) << 20;
+
+template<class T>
+class huge_page_allocator
+{
+public:
+    using value_type = T;
+
+    huge_page_allocator() noexcept = default;
+    template<class U>
+    huge_page_allocator(const huge_page_allocator<U> &) noexcept {}
+
+    // leaves room to round up to whole huge pages, plus one for the alignment, without overflow
+    static constexpr std::size_t max_size() noexcept
+    {
+        return (std::numeric_limits<std::size_t>::max() - 2 * huge_page_size) / sizeof(T);
+    }
+
+    T *allocate(std::size_t n)
+    {
+        if (n > max_size())
+            throw std::bad_array_new_length();
+        const std::size_t bytes = n * sizeof(T);
+        if (bytes < huge_page_size)
+            return std::allocator<T>().allocate(n);
+        const std::size_t length = round_up(bytes);
+        // map a page's worth extra, so there is a 2MB aligned start in it, and trim the rest off
+        void *mapped = mmap(nullptr, length + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            throw std::bad_alloc();
+        auto *base = static_cast<std::byte *>(mapped);
+        auto *aligned = reinterpret_cast<std::byte *>(round_up(reinterpret_cast<std::uintptr_t>(base)));
+        if (aligned != base)
+            munmap(base, aligned - base);
+        if (const std::size_t tail = (base + length + huge_page_size) - (aligned + length))
+            munmap(aligned + length, tail);
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+        return reinterpret_cast<T *>(aligned);
+    }
+
+    void deallocate(T *p, std::size_t n) noexcept
+    {
+        const std::size_t bytes = n * sizeof(T);
+        if (bytes < huge_page_size)
+            return std::allocator<T>().deallocate(p, n);
+        munmap(p, round_up(bytes));
+    }
+
+    // stateless, any two can free each other's memory
+    template<class U>
+    bool operator==(const huge_page_allocator<U> &) const noexcept { return true; }
+
+private:
+    static constexpr std::size_t round_up(std::size_t bytes) noexcept
+    {
+        return (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+    }
+};
+
+// fault in the pages of [p, p + length) now, one write per small page. If the huge page advice was
+// taken the first write of each 2MB faults in the whole huge page and the rest are plain stores.
+// Only for raw storage (or memory whose contents don't matter), it writes zero bytes
+inline void prefault(void *p, std::size_t length) noexcept
+{
+    constexpr std::size_t small_page_size = 4096;
+    auto *bytes = static_cast<volatile std::byte *>(p);
+    for (std::size_t offset = 0; offset < length; offset += small_page_size)
+        bytes[offset] = std::byte{0};
+}
+
+// reserve for a bulk build, and pre-fault the storage past size() that the fill will write
+template<class T, class Allocator>
+void reserve_prefaulted(std::vector<T, Allocator> &v, std::size_t n)
+{
+    v.reserve(n);
+    prefault(v.data() + v.size(), (v.capacity() - v.size()) * sizeof(T));
+}
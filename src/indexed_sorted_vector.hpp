@@ -0,0 +1,133 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+// A sorted_vector paired with a search index (eytzinger_index etc.).
+// Lookups go through the index, and every mutation rebuilds it, so they can never disagree.
+// Only the batch mutators are exposed, rebuilding after a single element insert would be silly.
+//
+// An Index needs:
+//   void rebuild(const Container&)
+//   size_type lower_bound(const Container&, const key_type&) const  -> position, as std::lower_bound
+// and may have, to be told which keys changed instead of rebuilding from scratch:
+//   void update(const Container&, const key_type &lo, const key_type &hi)  -> only keys in [lo, hi] changed
+// and, for filters (see bloom_filtered), to be told about the keys themselves, and to turn away misses:
+//   void inserted(const Container&, std::span<const key_type>)   -> after a batch insert, the batch's keys
+//   void erased(const Container&, size_type count)                 -> after an erase that removed count
+//   bool may_contain(const key_type&) const                         -> false skips the search in find()
+
+// The plain binary search the container already does, for decorators (bloom_filtered) that need an
+// Index to wrap
+template<class Key, class Compare = std::less<Key>>
+struct binary_search_index
+{
+    template<class Container>
+    void rebuild(const Container &) {}
+    template<class Container>
+    void update(const Container &, const Key &, const Key &) {}
+    template<class Container>
+    std::size_t lower_bound(const Container &sorted, const Key &key) const
+    {
+        return sorted_detail::lower_bound_between(sorted, 0, sorted.size(), key, Compare());
+    }
+};
+
+template<class Container, class Index>
+class indexed_sorted_vector
+{
+public:
+    using container_type = Container;
+    using index_type = Index;
+    using key_type = typename Container::key_type;
+    using value_type = typename Container::value_type;
+    using size_type = typename Container::size_type;
+    using const_iterator = typename Container::const_iterator;
+
+    indexed_sorted_vector() = default;
+    explicit indexed_sorted_vector(Container sorted, Index idx = Index())
+        : data(std::move(sorted)), index(std::move(idx))
+    {
+        index.rebuild(data);
+    }
+
+    const_iterator begin() const noexcept { return data.begin(); }
+    const_iterator end() const noexcept { return data.end(); }
+    const_iterator nth(size_type n) const noexcept { return data.nth(n); }
+    size_type size() const noexcept { return data.size(); }
+    bool empty() const noexcept { return data.empty(); }
+    const Container &container() const noexcept { return data; }
+    const Index &search_index() const noexcept { return index; }
+
+    const_iterator lower_bound(const key_type &key) const { return data.nth(index.lower_bound(data, key)); }
+    const_iterator find(const key_type &key) const
+    {
+        if constexpr (requires { index.may_contain(key); })
+            if (!index.may_contain(key))
+                return end();
+        const auto found = lower_bound(key);
+        return (found != end() && !data.key_comp()(key, found->k)) ? found : end();
+    }
+    bool contains(const key_type &key) const { return find(key) != end(); }
+
+    void batch_insert(std::vector<value_type> selection)
+    {
+        if (selection.empty())
+            return;
+        const auto [lo, hi] = std::minmax_element(selection.begin(), selection.end(), data.value_comp());
+        const key_type lo_key = lo->k;
+        const key_type hi_key = hi->k;
+        std::vector<key_type> keys;
+        if constexpr (requires { index.inserted(data, std::span<const key_type>(keys)); })
+        {
+            keys.reserve(selection.size());
+            for (const auto &entry : selection)
+                keys.push_back(entry.k);
+        }
+        data.batch_insert(std::move(selection));
+        changed(lo_key, hi_key);
+        if constexpr (requires { index.inserted(data, std::span<const key_type>(keys)); })
+            index.inserted(data, std::span<const key_type>(keys));
+    }
+    size_type batch_erase(std::vector<key_type> selection)
+    {
+        if (selection.empty())
+            return 0;
+        const auto [lo, hi] = std::minmax_element(selection.begin(), selection.end(), data.key_comp());
+        const key_type lo_key = *lo;
+        const key_type hi_key = *hi;
+        const size_type retval = data.batch_erase(std::move(selection));
+        if (retval)
+            changed(lo_key, hi_key, retval);
+        return retval;
+    }
+    size_type erase_range(const key_type &lo, const key_type &hi)
+    {
+        const size_type retval = data.erase_range(lo, hi);
+        if (retval)
+            changed(lo, hi, retval);
+        return retval;
+    }
+
+private:
+    void changed(const key_type &lo, const key_type &hi)
+    {
+        if constexpr (requires { index.update(data, lo, hi); })
+            index.update(data, lo, hi);
+        else
+            index.rebuild(data);
+    }
+    // after removing erased elements
+    void changed(const key_type &lo, const key_type &hi, size_type erased)
+    {
+        changed(lo, hi);
+        if constexpr (requires { index.erased(data, erased); })
+            index.erased(data, erased);
+    }
+
+    Container data;
+    Index index;
+};
@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <vector>
+#include "sorted_vector.hpp"
+// Interleaved lookups (AMAC: asynchronous memory access chaining), for big batches of unsorted keys.
+// One binary search over a vector much bigger than the cache is a chain of ~log n dependent misses,
+// the core sits idle for each one. Here a group of searches runs side by side, as a round robin of
+// small state machines: each one does a probe (its line was prefetched the round before), prefetches
+// its next probe, and hands over to the next search. With a group of G, G misses are in flight at
+// once, so a batch costs about log n misses in total per G queries instead of per query.
+// When a search finishes its slot takes the next query from the stream, so the group stays full.
+// Results come back in query order. Unlike find_many nothing is sorted, so this suits streams
+// whose keys are spread all over the vector.
+// The coroutine version of this is the same loop with the state hidden in a frame, but a frame is
+// an allocation (unless the compiler elides it, which it can't for a group), and the state here is
+// only two words.
+
+namespace interleaved
+{
+inline constexpr std::size_t default_group = 16;
+inline constexpr std::size_t max_group = 64;
+
+/*
+find:
+ position of each query (sorted.size() if missing) to out, in query order
+ group searches are in flight at once, 1 is a plain branchless binary search per key
+ Precondition: out.size() == queries.size(), 0 < group <= max_group
+*/
+template<class SortedVector, class Key>
+void find(const SortedVector &sorted, std::span<const Key> queries, std::span<std::size_t> out, std::size_t group = default_group)
+{
+    const std::size_t n = sorted.size();
+    if (n == 0)
+    {
+        std::fill(out.begin(), out.end(), n);
+        return;
+    }
+    const auto comp = sorted.key_comp();
+    const auto *const data = &*sorted.begin();
+
+    // the answer is in [base, base + len], len > 0
+    struct search
+    {
+        std::size_t query;
+        std::size_t base;
+        std::size_t len;
+    };
+    std::array<search, max_group> lanes;
+    std::size_t active = std::min({group, max_group, queries.size()});
+    std::size_t next_query = 0;
+    const auto start = [&](search &s) {
+        s = {next_query++, 0, n};
+        __builtin_prefetch(data + n / 2);
+    };
+    for (std::size_t i = 0; i < active; ++i)
+        start(lanes[i]);
+
+    while (active > 0)
+    {
+        for (std::size_t i = 0; i < active;)
+        {
+            search &s = lanes[i];
+            const Key &key = queries[s.query];
+            if (s.len > 1)
+            {
+                // one step of the branchless search, then prefetch the probe of the next one
+                const std::size_t half = s.len / 2;
+                s.base = comp(data[s.base + half].k, key) ? s.base + half : s.base;
+                s.len -= half;
+                __builtin_prefetch(data + s.base + s.len / 2);
+                ++i;
+                continue;
+            }
+            // down to one element, [base, base + 1]
+            const std::size_t pos = s.base + comp(data[s.base].k, key);
+            out[s.query] = (pos != n && !comp(key, data[pos].k)) ? pos : n;
+            if (next_query < queries.size())
+                start(s);
+            else
+                s = lanes[--active]; // the group shrinks as the stream runs out, refill this slot from the end
+        }
+    }
+}
+
+// as above, allocating the result
+template<class SortedVector, class Key>
+std::vector<std::size_t> find(const SortedVector &sorted, std::span<const Key> queries, std::size_t group = default_group)
+{
+    std::vector<std::size_t> retval(queries.size());
+    find(sorted, queries, std::span<std::size_t>(retval), group);
+    return retval;
+}
+} // interleaved
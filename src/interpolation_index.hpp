@@ -0,0 +1,72 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include "sorted_vector.hpp"
+// Interpolation search, as a search index for indexed_sorted_vector. Keeps nothing, so there is
+// nothing to rebuild.
+// On evenly spread keys (like the iota keys in the timings) the first guess from the key values is
+// within a few slots of the answer, so a lookup is a couple of probes instead of log n. Each guess
+// is guarded: the key guard_width slots further on is probed too, and if it brackets the answer
+// the range shrinks to guard_width at once. Skewed keys can make interpolation crawl, so after
+// max_steps guesses whatever range is left goes to the binary search, which bounds the worst case.
+// Arithmetic keys in ascending order only, the guess needs key differences.
+
+template<class Key, class Compare = std::less<Key>>
+class interpolation_index
+{
+    static_assert(simd_search::accelerated<Key, Compare>, "interpolation needs arithmetic keys in ascending order");
+
+public:
+    static constexpr std::size_t guard_width = 32;
+    static constexpr int max_steps = 4;
+
+    template<class SortedVector>
+    void rebuild(const SortedVector &) {}
+    template<class SortedVector>
+    void update(const SortedVector &, const Key &, const Key &) {}
+
+    // same position std::lower_bound would give on the sorted vector (size() if none)
+    template<class SortedVector>
+    std::size_t lower_bound(const SortedVector &sorted, const Key &key) const
+    {
+        // the answer is in [lo, hi]
+        std::size_t lo = 0;
+        std::size_t hi = sorted.size();
+        for (int step = 0; step < max_steps && hi - lo > guard_width; ++step)
+        {
+            const Key low_key = sorted.nth(lo)->k;
+            const Key high_key = sorted.nth(hi - 1)->k;
+            if (!comp(low_key, key))
+                return lo;
+            if (comp(high_key, key))
+                return hi;
+            // low_key < key <= high_key, but big 64 bit keys can round to the same double, and
+            // rounding can push the fraction past 1, so fall back on a flat span and clamp the guess
+            const double span = double(high_key) - double(low_key);
+            const double fraction = (double(key) - double(low_key)) / span;
+            if (!(span > 0) || !std::isfinite(fraction))
+                break;
+            const std::size_t guess = lo + std::size_t(std::clamp(fraction, 0.0, 1.0) * double(hi - 1 - lo));
+            if (comp(sorted.nth(guess)->k, key))
+            {
+                lo = guess + 1;
+                const std::size_t guard = std::min(guess + guard_width, hi - 1);
+                if (!comp(sorted.nth(guard)->k, key))
+                    hi = guard;
+            }
+            else
+            {
+                hi = guess;
+                const std::size_t guard = guess > lo + guard_width ? guess - guard_width : lo;
+                if (comp(sorted.nth(guard)->k, key))
+                    lo = guard + 1;
+            }
+        }
+        return sorted_detail::lower_bound_between(sorted, lo, hi, key, comp);
+    }
+
+private:
+    [[no_unique_address]] Compare comp;
+};
@@ -0,0 +1,162 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "sorted_vector.hpp"
+// Piecewise linear learned index (PGM style), a search index for indexed_sorted_vector.
+// The key -> position curve of the sorted vector is cut into segments, each a straight line that
+// predicts every position it covers to within Epsilon. A lookup finds the segment (binary search
+// over the segments' first keys, a small array that stays in cache), then searches the
+// 2 * Epsilon window around the prediction. For near uniform keys a handful of segments covers
+// millions of elements, so the lookup is one or two cache misses instead of log n.
+//
+// Segments are fitted in one pass with a shrinking cone: anchored at the segment's first point,
+// each point narrows the range of slopes that keeps every point within Epsilon, and when the range
+// is empty the point starts a new segment.
+// After a batch update only the segments covering the changed key range are refitted, the ones
+// after it just shift by the change in size (see update()).
+// The window is checked at its edges, and falls back to a full search if the prediction was off
+// (it can be for huge keys, which lose precision as doubles), so lookups are always exact.
+
+template<class Key, class Compare = std::less<Key>, std::size_t Epsilon = 32>
+class learned_index
+{
+    static_assert(simd_search::accelerated<Key, Compare>, "the segments need arithmetic keys in ascending order");
+
+public:
+    learned_index() = default;
+    template<class SortedVector>
+    explicit learned_index(const SortedVector &sorted)
+    {
+        rebuild(sorted);
+    }
+
+    template<class SortedVector>
+    void rebuild(const SortedVector &sorted)
+    {
+        segments.clear();
+        firsts.clear();
+        fit(sorted, 0, sorted.size(), segments);
+        n = sorted.size();
+        refresh_firsts();
+    }
+
+    // sorted has changed, but only for keys in [lo, hi]: refit the segments that overlap that range,
+    // and shift the ones after it
+    template<class SortedVector>
+    void update(const SortedVector &sorted, const Key &lo, const Key &hi)
+    {
+        if (segments.empty())
+            return rebuild(sorted);
+        // [first, last) overlap [lo, hi]. Nothing before lo moved, so first's start still holds
+        const std::size_t first = segment_for(lo);
+        const std::size_t last = std::upper_bound(firsts.begin(), firsts.end(), hi, comp) - firsts.begin();
+        const std::ptrdiff_t delta = std::ptrdiff_t(sorted.size()) - std::ptrdiff_t(n);
+        const std::size_t from = segments[first].start;
+        const std::size_t to = last < segments.size() ? segments[last].start + delta : sorted.size();
+
+        std::vector<segment> refitted;
+        fit(sorted, from, to, refitted);
+        for (std::size_t i = last; i < segments.size(); ++i)
+            segments[i].start += delta;
+        segments.erase(segments.begin() + first, segments.begin() + last);
+        segments.insert(segments.begin() + first, refitted.begin(), refitted.end());
+        n = sorted.size();
+        refresh_firsts();
+    }
+
+    std::size_t segment_count() const noexcept { return segments.size(); }
+
+    // same position std::lower_bound would give on the sorted vector (size() if none)
+    template<class SortedVector>
+    std::size_t lower_bound(const SortedVector &sorted, const Key &key) const
+    {
+        if (segments.empty())
+            return 0;
+        const std::size_t s = segment_for(key);
+        const segment &seg = segments[s];
+        const std::size_t end = s + 1 < segments.size() ? segments[s + 1].start : n;
+        const double predicted = double(seg.start) + seg.slope * (double(key) - double(seg.first));
+        // clamped to the segment, keys past its last element belong at end
+        const std::size_t guess = std::size_t(std::clamp(predicted, double(seg.start), double(end)));
+        const std::size_t lo = guess > seg.start + Epsilon + 1 ? guess - Epsilon - 1 : seg.start;
+        const std::size_t hi = std::min(end, guess + Epsilon + 2);
+        const std::size_t retval = sorted_detail::lower_bound_between(sorted, lo, hi, key, comp);
+        // the answer is in the window unless it ended up on an edge it shouldn't have
+        if ((retval == lo && lo > 0 && !comp(sorted.nth(lo - 1)->k, key)) ||
+            (retval == hi && hi < n && comp(sorted.nth(hi)->k, key)))
+            return sorted_detail::lower_bound_between(sorted, 0, n, key, comp);
+        return retval;
+    }
+
+private:
+    struct segment
+    {
+        Key first;
+        double slope;
+        std::size_t start; // position of first
+    };
+
+    // the segment whose range holds key (the first one for keys before everything)
+    std::size_t segment_for(const Key &key) const
+    {
+        const std::size_t after = std::upper_bound(firsts.begin(), firsts.end(), key, comp) - firsts.begin();
+        return after == 0 ? 0 : after - 1;
+    }
+
+    void refresh_firsts()
+    {
+        firsts.resize(segments.size());
+        for (std::size_t i = 0; i < segments.size(); ++i)
+            firsts[i] = segments[i].first;
+    }
+
+    // fit segments to positions [from, to) of sorted, appending them to out
+    template<class SortedVector>
+    static void fit(const SortedVector &sorted, std::size_t from, std::size_t to, std::vector<segment> &out)
+    {
+        constexpr double eps = double(Epsilon);
+        std::size_t start = from;
+        double origin = 0;
+        double min_slope = 0;
+        double max_slope = std::numeric_limits<double>::infinity();
+        const auto close = [&] {
+            const double slope = max_slope == std::numeric_limits<double>::infinity() ? 0 : (min_slope + max_slope) / 2;
+            out.push_back({sorted.nth(start)->k, slope, start});
+        };
+        for (std::size_t i = from; i < to; ++i)
+        {
+            const double x = double(sorted.nth(i)->k);
+            if (i == start)
+            {
+                origin = x;
+                continue;
+            }
+            const double dx = x - origin;
+            const double dy = double(i - start);
+            // dx is 0 only for huge keys that round to the same double, those need a new segment
+            const double lo = dx > 0 ? std::max(min_slope, (dy - eps) / dx) : 1;
+            const double hi = dx > 0 ? std::min(max_slope, (dy + eps) / dx) : 0;
+            if (lo > hi)
+            {
+                close();
+                start = i;
+                origin = x;
+                min_slope = 0;
+                max_slope = std::numeric_limits<double>::infinity();
+                continue;
+            }
+            min_slope = lo;
+            max_slope = hi;
+        }
+        if (start < to)
+            close();
+    }
+
+    std::vector<segment> segments;
+    std::vector<Key> firsts; // segments[i].first, packed for the search
+    std::size_t n{0};
+    [[no_unique_address]] Compare comp;
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+// Log-structured sorted vector, for when the inserts really do arrive one at a time.
+// New elements go into a small sorted staging buffer (a cheap memmove, it's small). When the
+// buffer fills it becomes a sorted run, and runs are merged LSM style whenever the older run is
+// less than twice the size of the newer one. That keeps O(log n) runs, and each element is moved
+// O(log n) times over its life, so a single insert costs amortised O(log n) moves instead of O(n).
+// Lookups check the buffer and then each run, newest first.
+// Keys are unique across buffer and runs (insert checks first), so size() is exact, and
+// compact() folds everything back into one plain sorted_vector for scanning.
+
+template<class Key, class Value, class Compare = std::less<Key>>
+class lsm_sorted_vector
+{
+public:
+    using run_type = sorted_vector<Key, Value, Compare>;
+    using key_type = Key;
+    using value_type = typename run_type::value_type;
+    using size_type = typename run_type::size_type;
+
+    static constexpr size_type default_buffer_size = 256;
+
+    explicit lsm_sorted_vector(size_type buffer_size = default_buffer_size)
+        : buffer_size(buffer_size)
+    {
+        buffer.reserve(buffer_size);
+    }
+    // start from an existing sorted_vector, as the oldest run
+    explicit lsm_sorted_vector(run_type base, size_type buffer_size = default_buffer_size)
+        : lsm_sorted_vector(buffer_size)
+    {
+        if (!base.empty())
+            runs.push_back(std::move(base));
+    }
+
+    size_type size() const noexcept
+    {
+        size_type retval = buffer.size();
+        for (const auto &run : runs)
+            retval += run.size();
+        return retval;
+    }
+    bool empty() const noexcept { return size() == 0; }
+    // number of sorted runs, not counting the buffer
+    size_type run_count() const noexcept { return runs.size(); }
+
+    // nullptr if not present
+    const value_type *find(const Key &key) const
+    {
+        if (const auto found = buffer.find(key); found != buffer.end())
+            return &*found;
+        for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+            if (const auto found = run->find(key); found != run->end())
+                return &*found;
+        return nullptr;
+    }
+    bool contains(const Key &key) const { return find(key) != nullptr; }
+
+    // as std::map::insert, an existing key is not replaced. returns true if inserted
+    bool insert(value_type value)
+    {
+        if (contains(value.k))
+            return false;
+        buffer.insert(std::move(value));
+        if (buffer.size() >= buffer_size)
+            flush();
+        return true;
+    }
+
+    // O(size of the run holding the key), the same memmove as sorted_vector. The oldest run holds at
+    // least half the elements, so for most keys that is the base run, and the erase is O(n)
+    size_type erase(const Key &key)
+    {
+        if (buffer.erase(key))
+            return 1;
+        for (auto run = runs.rbegin(); run != runs.rend(); ++run)
+            if (run->erase(key))
+                return 1;
+        return 0;
+    }
+
+    // turn the buffer into a run, and merge runs until the sizes are geometric again
+    void flush()
+    {
+        if (buffer.empty())
+            return;
+        runs.push_back(std::move(buffer));
+        buffer = run_type{};
+        buffer.reserve(buffer_size);
+        while (runs.size() >= 2 && runs[runs.size() - 2].size() < 2 * runs.back().size())
+        {
+            run_type newer = std::move(runs.back());
+            runs.pop_back();
+            runs.back() = merge(std::move(runs.back()), std::move(newer));
+        }
+    }
+
+    // everything merged into one sorted_vector, for contiguous scanning
+    const run_type &compact()
+    {
+        flush();
+        while (runs.size() >= 2)
+        {
+            run_type newer = std::move(runs.back());
+            runs.pop_back();
+            runs.back() = merge(std::move(runs.back()), std::move(newer));
+        }
+        if (runs.empty())
+            runs.emplace_back();
+        return runs.front();
+    }
+
+private:
+    // keys never repeat between runs, so a plain merge gives a valid run
+    static run_type merge(run_type older, run_type newer)
+    {
+        const auto comp = older.value_comp();
+        auto a = std::move(older).extract();
+        auto b = std::move(newer).extract();
+        typename run_type::container_type merged(a.get_allocator());
+        merged.reserve(a.size() + b.size());
+        std::merge(std::make_move_iterator(a.begin()), std::make_move_iterator(a.end()),
+                   std::make_move_iterator(b.begin()), std::make_move_iterator(b.end()),
+                   std::back_inserter(merged), comp);
+        return run_type{sorted_unique, std::move(merged)};
+    }
+
+    run_type buffer;
+    std::vector<run_type> runs; // oldest (biggest) first
+    size_type buffer_size;
+};
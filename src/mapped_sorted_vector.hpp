@@ -0,0 +1,317 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "simd_lower_bound.hpp"
+// On-disk sorted vector, opened with mmap and searched in place, so a big table is ready as soon as
+// the file is mapped instead of being rebuilt (CreateVector) at every start.
+//
+// File layout (native byte order, every section 64 byte aligned):
+//   header
+//   keys        count fixed width keys, sorted
+//   offsets     count + 1 uint64, value i is heap[offsets[i], offsets[i + 1])
+//   heap        the value bytes, back to back
+//   samples     optional, every sample_stride'th key, a first level to search before the keys
+// Values are stored as bytes, anything that converts to std::string_view can be saved, and they are
+// read back as std::string_view pointing into the mapping.
+// Errors (can't open, bad magic, wrong version or key type, sections that are misaligned or run
+// past the end of the file) throw.
+
+namespace mapped_format
+{
+inline constexpr char magic[8] = {'S', 'O', 'R', 'T', 'V', 'E', 'C', '\0'};
+inline constexpr std::uint32_t version = 1;
+inline constexpr std::uint32_t byte_order_mark = 0x01020304;
+// keys per sample, one cache line of 4 byte keys
+inline constexpr std::uint64_t sample_stride = 16;
+
+struct header
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint32_t key_size;
+    std::uint32_t key_is_signed;
+    std::uint64_t count;
+    std::uint64_t keys_offset;
+    std::uint64_t offsets_offset;
+    std::uint64_t heap_offset;
+    std::uint64_t heap_size;
+    std::uint64_t samples_offset; // 0 if there is no index
+    std::uint64_t sample_count;
+};
+
+inline std::uint64_t align(std::uint64_t pos) { return (pos + 63) / 64 * 64; }
+} // mapped_format
+
+// Writes the format one entry at a time, for when the entries aren't all in memory (or even counted)
+// up front. The keys go straight to the file, the offsets and value bytes go to two temporary files
+// beside it, and finish() appends them and fills in the header. Entries must be appended in order.
+template<class Key>
+class mapped_writer
+{
+public:
+    static_assert(std::is_trivially_copyable_v<Key>, "keys are written as raw bytes");
+
+    explicit mapped_writer(const std::string &path, bool with_index = true)
+        : path(path), with_index(with_index),
+          out(path, std::ios::binary | std::ios::trunc),
+          offsets(path + ".offsets", std::ios::binary | std::ios::trunc),
+          heap(path + ".heap", std::ios::binary | std::ios::trunc)
+    {
+        if (!out || !offsets || !heap)
+            throw std::runtime_error("can't create " + path);
+        pad_to(out, mapped_format::align(sizeof(mapped_format::header)));
+        const std::uint64_t zero = 0;
+        offsets.write(reinterpret_cast<const char *>(&zero), sizeof(zero));
+    }
+    ~mapped_writer()
+    {
+        std::remove((path + ".offsets").c_str());
+        std::remove((path + ".heap").c_str());
+    }
+    mapped_writer(const mapped_writer &) = delete;
+    mapped_writer &operator=(const mapped_writer &) = delete;
+
+    void append(const Key &key, std::string_view value)
+    {
+        if (with_index && count % mapped_format::sample_stride == 0)
+            samples.push_back(key);
+        out.write(reinterpret_cast<const char *>(&key), sizeof(Key));
+        heap.write(value.data(), value.size());
+        heap_size += value.size();
+        offsets.write(reinterpret_cast<const char *>(&heap_size), sizeof(heap_size));
+        ++count;
+    }
+
+    void finish()
+    {
+        namespace mf = mapped_format;
+        mf::header h{};
+        std::memcpy(h.magic, mf::magic, sizeof(h.magic));
+        h.version = mf::version;
+        h.byte_order = mf::byte_order_mark;
+        h.key_size = sizeof(Key);
+        h.key_is_signed = std::is_signed_v<Key>;
+        h.count = count;
+        h.keys_offset = mf::align(sizeof(h));
+        h.offsets_offset = append_section(offsets, path + ".offsets");
+        h.heap_offset = append_section(heap, path + ".heap");
+        h.heap_size = heap_size;
+        if (with_index)
+        {
+            h.samples_offset = pad_to(out, mf::align(out.tellp()));
+            h.sample_count = samples.size();
+            out.write(reinterpret_cast<const char *>(samples.data()), samples.size() * sizeof(Key));
+        }
+        out.seekp(0);
+        out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        if (!out.flush())
+            throw std::runtime_error("failed writing " + path);
+    }
+
+private:
+    static std::uint64_t pad_to(std::ofstream &os, std::uint64_t pos)
+    {
+        static const char zeros[64] = {};
+        os.write(zeros, pos - std::uint64_t(os.tellp()));
+        return pos;
+    }
+
+    // copy a temporary file onto the end of out, 64 byte aligned, and return where it starts
+    std::uint64_t append_section(std::ofstream &section, const std::string &section_path)
+    {
+        const std::uint64_t retval = pad_to(out, mapped_format::align(out.tellp()));
+        if (!section.flush())
+            throw std::runtime_error("failed writing " + section_path);
+        section.close();
+        std::ifstream in(section_path, std::ios::binary);
+        if (in.peek() != std::ifstream::traits_type::eof())
+            out << in.rdbuf();
+        return retval;
+    }
+
+    std::string path;
+    bool with_index;
+    std::ofstream out, offsets, heap;
+    std::uint64_t count{0};
+    std::uint64_t heap_size{0};
+    std::vector<Key> samples;
+};
+
+// Write a sorted_vector (or anything with the same begin/end and ->k/->v) to path.
+template<class SortedVector>
+void save(const SortedVector &sorted, const std::string &path, bool with_index = true)
+{
+    mapped_writer<typename SortedVector::key_type> writer(path, with_index);
+    for (const auto &entry : sorted)
+        writer.append(entry.k, std::string_view(entry.v));
+    writer.finish();
+}
+
+// Read only view of a file written by save(). Nothing is read until it is touched, opening is
+// an open() and an mmap().
+template<class Key, class Compare = std::less<Key>>
+class mapped_sorted_vector
+{
+public:
+    using key_type = Key;
+    using size_type = std::size_t;
+
+    explicit mapped_sorted_vector(const std::string &path)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "can't open " + path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::generic_category(), "can't stat " + path);
+        }
+        length = st.st_size;
+        void *p = length ? ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (p == MAP_FAILED)
+            throw std::runtime_error("can't map " + path);
+        base = static_cast<const std::byte *>(p);
+        try
+        {
+            validate(path);
+        }
+        catch (...)
+        {
+            ::munmap(const_cast<std::byte *>(base), length);
+            throw;
+        }
+    }
+    ~mapped_sorted_vector()
+    {
+        if (base)
+            ::munmap(const_cast<std::byte *>(base), length);
+    }
+    mapped_sorted_vector(const mapped_sorted_vector &) = delete;
+    mapped_sorted_vector &operator=(const mapped_sorted_vector &) = delete;
+
+    size_type size() const noexcept { return h->count; }
+    bool empty() const noexcept { return size() == 0; }
+    bool has_index() const noexcept { return samples != nullptr; }
+
+    const Key &key(size_type i) const noexcept { return keys[i]; }
+    // throws if the file's offsets for entry i are corrupt
+    std::string_view value(size_type i) const
+    {
+        const std::uint64_t first = offsets[i];
+        const std::uint64_t last = offsets[i + 1];
+        if (first > last || last > h->heap_size)
+            throw std::runtime_error("corrupt value offsets");
+        return {reinterpret_cast<const char *>(heap + first), std::size_t(last - first)};
+    }
+
+    // position of the first key not less than key, size() if none
+    size_type lower_bound(const Key &key) const
+    {
+        if (!samples)
+            return search(keys, size(), key);
+        // first level: the samples say which block of sample_stride keys holds the answer
+        const size_type sample = search(samples, h->sample_count, key);
+        if (sample == 0)
+            return 0;
+        const size_type first = (sample - 1) * mapped_format::sample_stride;
+        const size_type last = std::min<size_type>(first + mapped_format::sample_stride, size());
+        return first + search(keys + first, last - first, key);
+    }
+    // position of key, size() if missing
+    size_type find(const Key &key) const
+    {
+        const size_type found = lower_bound(key);
+        return (found != size() && !comp(key, keys[found])) ? found : size();
+    }
+    bool contains(const Key &key) const { return find(key) != size(); }
+
+    // calls fn(key, value) for every key in [lo, hi), in order
+    template<class Fn>
+    void scan(const Key &lo, const Key &hi, Fn &&fn) const
+    {
+        for (size_type i = lower_bound(lo); i < size() && comp(keys[i], hi); ++i)
+            fn(keys[i], value(i));
+    }
+
+private:
+    size_type search(const Key *first, size_type n, const Key &key) const
+    {
+        if constexpr (simd_search::accelerated<Key, Compare>)
+            return simd_search::lower_bound(first, n, sizeof(Key), key);
+        else
+            return std::lower_bound(first, first + n, key, comp) - first;
+    }
+
+    void validate(const std::string &path)
+    {
+        namespace mf = mapped_format;
+        const auto bad = [&path](const char *why) { return std::runtime_error(path + ": " + why); };
+        if (length < sizeof(mf::header))
+            throw bad("too short for a header");
+        h = reinterpret_cast<const mf::header *>(base);
+        if (std::memcmp(h->magic, mf::magic, sizeof(mf::magic)) != 0)
+            throw bad("not a sorted vector file");
+        if (h->version != mf::version)
+            throw bad("unsupported version");
+        if (h->byte_order != mf::byte_order_mark)
+            throw bad("written with a different byte order");
+        if (h->key_size != sizeof(Key) || bool(h->key_is_signed) != std::is_signed_v<Key>)
+            throw bad("key type doesn't match");
+        // every section aligned, after the header, and n elements of size bytes inside the file
+        const auto check_section = [&](std::uint64_t offset, std::uint64_t n, std::uint64_t size) {
+            if (offset % 64 != 0 || offset < mf::align(sizeof(mf::header)))
+                throw bad("misaligned section");
+            if (offset > length || n > (length - offset) / size)
+                throw bad("truncated");
+        };
+        check_section(h->keys_offset, h->count, sizeof(Key));
+        if (h->count == std::numeric_limits<std::uint64_t>::max())
+            throw bad("truncated");
+        check_section(h->offsets_offset, h->count + 1, sizeof(std::uint64_t));
+        check_section(h->heap_offset, h->heap_size, 1);
+        if (h->samples_offset)
+        {
+            check_section(h->samples_offset, h->sample_count, sizeof(Key));
+            // lower_bound maps sample i to keys [(i - 1) * stride, i * stride)
+            if (h->sample_count != (h->count + mf::sample_stride - 1) / mf::sample_stride)
+                throw bad("index doesn't match the keys");
+        }
+        keys = reinterpret_cast<const Key *>(base + h->keys_offset);
+        offsets = reinterpret_cast<const std::uint64_t *>(base + h->offsets_offset);
+        heap = base + h->heap_offset;
+        samples = h->samples_offset ? reinterpret_cast<const Key *>(base + h->samples_offset) : nullptr;
+        // the offsets in between are checked as each value is read, checking them all here would
+        // read the whole section and make opening O(n)
+        if (offsets[0] != 0 || offsets[h->count] > h->heap_size)
+            throw bad("value offsets out of range");
+    }
+
+    const std::byte *base{nullptr};
+    std::size_t length{0};
+    const mapped_format::header *h{nullptr};
+    const Key *keys{nullptr};
+    const std::uint64_t *offsets{nullptr};
+    const std::byte *heap{nullptr};
+    const Key *samples{nullptr};
+    [[no_unique_address]] Compare comp;
+};
@@ -0,0 +1,288 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+// Packed memory array: a sorted vector with gaps, for when single inserts and erases can't be
+// batched. The slots are cut into segments of ~log n slots, and each segment keeps its elements
+// packed at its front, so a single insert or erase only shifts the rest of one segment.
+// When a segment fills up (or empties out) the smallest enclosing window of 2, 4, 8... segments
+// whose density is still within bounds is rebalanced: its elements are spread evenly over it again.
+// The bounds get tighter the bigger the window, so big rebalances are rare, and the cost works out
+// at O(log^2 n) amortised moves per update. If the whole array is out of bounds it doubles
+// (or halves) and everything is spread out.
+// Elements stay in key order in memory, so a scan is sequential, it just steps over the gaps.
+// Lookups are a binary search over the segments' first keys, then over one segment.
+// No segment is ever left empty, except at the end when there are fewer elements than segments:
+// an erase that empties one always rebalances, and a rebalanced window has at least
+// lower_leaf * segment_size >= 1 elements per segment. So the non empty segments are a prefix,
+// and the first key of every segment searched is right there, O(1) per probe.
+// Values must be default constructible, the gaps are default constructed entries.
+
+template<class Key, class Value, class Compare = std::less<Key>>
+class packed_memory_array
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = sorted_entry<Key, Value>;
+    using size_type = std::size_t;
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = packed_memory_array::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = const value_type &;
+        using pointer = const value_type *;
+
+        const_iterator() = default;
+        const_iterator(const packed_memory_array *c, size_type slot) noexcept : c(c), slot(slot) {}
+        reference operator*() const noexcept { return c->slots[slot]; }
+        pointer operator->() const noexcept { return &c->slots[slot]; }
+        const_iterator &operator++() noexcept
+        {
+            const size_type seg = slot / c->segment_size;
+            slot = (slot + 1 < seg * c->segment_size + c->counts[seg]) ? slot + 1 : c->first_slot_from(seg + 1);
+            return *this;
+        }
+        const_iterator operator++(int) noexcept
+        {
+            auto retval = *this;
+            ++*this;
+            return retval;
+        }
+        friend bool operator==(const const_iterator &a, const const_iterator &b) noexcept { return a.slot == b.slot; }
+
+    private:
+        const packed_memory_array *c{nullptr};
+        size_type slot{0};
+    };
+
+    explicit packed_memory_array(const Compare &comp = Compare()) : comp(comp) { resize(min_capacity); }
+    // adopt the contents of a sorted_vector, spread out at half density
+    explicit packed_memory_array(sorted_vector<Key, Value, Compare> sorted)
+        : comp(sorted.key_comp())
+    {
+        auto entries = std::move(sorted).extract();
+        count = entries.size();
+        resize(std::max(min_capacity, std::bit_ceil(2 * count)));
+        spread(entries, 0, segment_count());
+    }
+
+    const_iterator begin() const noexcept { return {this, first_slot_from(0)}; }
+    const_iterator end() const noexcept { return {this, slots.size()}; }
+    size_type size() const noexcept { return count; }
+    bool empty() const noexcept { return count == 0; }
+    // slots, used or not
+    size_type capacity() const noexcept { return slots.size(); }
+
+    const_iterator lower_bound(const Key &key) const { return {this, lower_bound_slot(key)}; }
+    const_iterator find(const Key &key) const
+    {
+        const auto found = lower_bound(key);
+        return (found != end() && !comp(key, found->k)) ? found : end();
+    }
+    bool contains(const Key &key) const { return find(key) != end(); }
+
+    // as std::map::insert, an existing key is not replaced. returns true if inserted
+    bool insert(value_type value)
+    {
+        size_type seg = segment_for(value.k);
+        auto first = slots.begin() + seg * segment_size;
+        auto pos = std::lower_bound(first, first + counts[seg], value.k, value_comp());
+        if (pos != first + counts[seg] && !comp(value.k, pos->k))
+            return false;
+        if (counts[seg] == segment_size)
+        {
+            // no room, spread the neighbourhood out (or grow) and look again
+            make_room(seg);
+            seg = segment_for(value.k);
+            first = slots.begin() + seg * segment_size;
+            pos = std::lower_bound(first, first + counts[seg], value.k, value_comp());
+        }
+        std::move_backward(pos, first + counts[seg], first + counts[seg] + 1);
+        *pos = std::move(value);
+        ++counts[seg];
+        ++count;
+        used = std::max(used, seg + 1);
+        return true;
+    }
+
+    size_type erase(const Key &key)
+    {
+        const size_type slot = lower_bound_slot(key);
+        if (slot == slots.size() || comp(key, slots[slot].k))
+            return 0;
+        const size_type seg = slot / segment_size;
+        const auto first = slots.begin() + seg * segment_size;
+        std::move(slots.begin() + slot + 1, first + counts[seg], slots.begin() + slot);
+        first[--counts[seg]] = value_type{};
+        --count;
+        if (counts[seg] < lower_density(0) * segment_size)
+            thin_out(seg);
+        return 1;
+    }
+
+private:
+    static constexpr size_type min_capacity = 64;
+    // density bounds, leaf segment to whole array
+    static constexpr double upper_leaf = 1.0;
+    static constexpr double upper_root = 0.75;
+    static constexpr double lower_leaf = 0.125;
+    static constexpr double lower_root = 0.25;
+
+    struct value_compare
+    {
+        Compare comp;
+        bool operator()(const value_type &a, const Key &b) const { return comp(a.k, b); }
+    };
+    value_compare value_comp() const { return value_compare{comp}; }
+
+    size_type segment_count() const noexcept { return counts.size(); }
+    size_type height() const noexcept { return std::bit_width(segment_count()) - 1; }
+    double upper_density(size_type level) const noexcept
+    {
+        return height() == 0 ? upper_root : upper_leaf - (upper_leaf - upper_root) * double(level) / double(height());
+    }
+    double lower_density(size_type level) const noexcept
+    {
+        return height() == 0 ? lower_root : lower_leaf + (lower_root - lower_leaf) * double(level) / double(height());
+    }
+
+    // empty, with capacity slots (a power of 2) in segments of about log2(capacity)
+    void resize(size_type capacity)
+    {
+        segment_size = std::max<size_type>(8, std::bit_ceil<size_type>(std::bit_width(capacity)));
+        slots.assign(capacity, value_type{});
+        counts.assign(capacity / segment_size, 0);
+        used = 0;
+    }
+
+    // first occupied slot at or after the start of segment seg, slots.size() if none
+    size_type first_slot_from(size_type seg) const noexcept
+    {
+        return seg < used ? seg * segment_size : slots.size();
+    }
+
+    // the last segment whose first key is not greater than key (the first one if key is before
+    // everything). Only the non empty prefix is searched
+    size_type segment_for(const Key &key) const
+    {
+        size_type lo = 0;
+        size_type hi = used;
+        while (lo < hi)
+        {
+            const size_type mid = lo + (hi - lo) / 2;
+            if (!comp(key, slots[mid * segment_size].k))
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo == 0 ? 0 : lo - 1;
+    }
+
+    size_type lower_bound_slot(const Key &key) const
+    {
+        if (count == 0)
+            return slots.size();
+        const size_type seg = segment_for(key);
+        const auto first = slots.begin() + seg * segment_size;
+        const auto found = std::lower_bound(first, first + counts[seg], key, value_comp());
+        if (found != first + counts[seg])
+            return found - slots.begin();
+        return first_slot_from(seg + 1);
+    }
+
+    // move the elements of segments [first, last) to out, in order
+    void gather(std::vector<value_type> &out, size_type first, size_type last)
+    {
+        for (size_type seg = first; seg < last; ++seg)
+        {
+            const auto begin = slots.begin() + seg * segment_size;
+            for (auto it = begin; it != begin + counts[seg]; ++it)
+            {
+                out.push_back(std::move(*it));
+                *it = value_type{};
+            }
+            counts[seg] = 0;
+        }
+    }
+
+    // share entries out evenly over segments [first, last), each packed at its front. With fewer
+    // entries than segments (only ever the whole array) they go one each to the first segments
+    void spread(std::vector<value_type> &entries, size_type first, size_type last)
+    {
+        const size_type segments = last - first;
+        used = std::max(used, first + std::min<size_type>(segments, entries.size()));
+        auto src = entries.begin();
+        for (size_type i = 0; i < segments; ++i)
+        {
+            const size_type n = entries.size() / segments + (i < entries.size() % segments);
+            std::move(src, src + n, slots.begin() + (first + i) * segment_size);
+            counts[first + i] = n;
+            src += n;
+        }
+        entries.clear();
+    }
+
+    void rebalance(size_type first, size_type last)
+    {
+        gather(buffer, first, last);
+        spread(buffer, first, last);
+    }
+
+    // the whole array is out of bounds, so change its size and spread everything over the new one
+    void reallocate(size_type capacity)
+    {
+        gather(buffer, 0, segment_count());
+        resize(capacity);
+        spread(buffer, 0, segment_count());
+    }
+
+    // segment seg is full: rebalance the smallest window around it with room for one more
+    void make_room(size_type seg)
+    {
+        for (size_type level = 1, width = 2; width <= segment_count(); ++level, width *= 2)
+        {
+            const size_type first = seg / width * width;
+            size_type held = 1;
+            for (size_type s = first; s < first + width; ++s)
+                held += counts[s];
+            // and spread out, no segment of the window may be full, or the insert still has no room
+            if (held <= upper_density(level) * double(width * segment_size) && held <= width * (segment_size - 1) + 1)
+                return rebalance(first, first + width);
+        }
+        reallocate(2 * slots.size());
+    }
+
+    // segment seg is too sparse: rebalance the smallest window around it that is dense enough
+    void thin_out(size_type seg)
+    {
+        for (size_type level = 1, width = 2; width <= segment_count(); ++level, width *= 2)
+        {
+            const size_type first = seg / width * width;
+            size_type held = 0;
+            for (size_type s = first; s < first + width; ++s)
+                held += counts[s];
+            if (held >= lower_density(level) * double(width * segment_size))
+                return rebalance(first, first + width);
+        }
+        // at the minimum size, spread it all out again, which closes the gap
+        reallocate(std::max(min_capacity, slots.size() / 2));
+    }
+
+    std::vector<value_type> slots;
+    std::vector<size_type> counts; // elements in each segment, packed at its front
+    std::vector<value_type> buffer; // for rebalancing, capacity kept
+    size_type segment_size{8};
+    size_type count{0};
+    size_type used{0}; // segments [0, used) are non empty, the rest are empty
+    [[no_unique_address]] Compare comp;
+};
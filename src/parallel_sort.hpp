@@ -0,0 +1,113 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+#include "thread_pool.hpp"
+// Parallel merge sort over a thread_pool: the range is cut into one chunk per thread, the chunks
+// are std::sort'ed concurrently, then neighbouring runs are merged pairwise until one run is left.
+// Every merge is itself split between the threads: the output of a pair is cut into equal pieces,
+// and a binary search on the two runs (co-ranking, the "merge path") finds where each piece starts
+// in each of them, so each thread merges its own piece and no step is serial over all n.
+// The merges ping-pong between the range and a buffer of n elements (raw storage, so nothing is
+// constructed up front), and a final parallel move brings the result back if it ended in the buffer.
+// The comparator must not throw.
+
+// below this it isn't worth waking anyone up
+inline constexpr std::size_t parallel_sort_cutoff = 1 << 16;
+
+namespace sorted_detail
+{
+// how many elements of a come before output position k in the stable merge of a and b
+template<class It, class Comp>
+std::size_t co_rank(std::size_t k, It a, std::size_t m, It b, std::size_t l, Comp comp)
+{
+    std::size_t lo = k > l ? k - l : 0;
+    std::size_t hi = std::min(k, m);
+    while (lo < hi)
+    {
+        const std::size_t i = lo + (hi - lo) / 2;
+        // ties go to a, so a[i] is only after b[k - i - 1] if it is strictly greater
+        if (comp(b[k - i - 1], a[i]))
+            hi = i;
+        else
+            lo = i + 1;
+    }
+    return lo;
+}
+
+// stable merge of [a, a_end) and [b, b_end) to out, moving. Construct: out is raw storage
+template<bool Construct, class In, class Out, class Comp>
+void merge_move(In a, In a_end, In b, In b_end, Out out, Comp comp)
+{
+    const auto put = [&out](auto &&value) {
+        if constexpr (Construct)
+            std::construct_at(std::addressof(*out), std::move(value));
+        else
+            *out = std::move(value);
+        ++out;
+    };
+    while (a != a_end && b != b_end)
+        put(comp(*b, *a) ? *b++ : *a++);
+    for (; a != a_end; ++a)
+        put(*a);
+    for (; b != b_end; ++b)
+        put(*b);
+}
+} // sorted_detail
+
+template<class It, class Comp>
+void parallel_sort(It first, It last, Comp comp, thread_pool &pool)
+{
+    using T = typename std::iterator_traits<It>::value_type;
+    const std::size_t n = last - first;
+    const std::size_t chunks = pool.size();
+    if (chunks == 1 || n < parallel_sort_cutoff)
+        return std::sort(first, last, comp);
+
+    // chunk i is [bounds[i], bounds[i + 1])
+    std::vector<std::size_t> bounds(chunks + 1);
+    for (std::size_t i = 0; i <= chunks; ++i)
+        bounds[i] = n * i / chunks;
+    pool.parallel_for(chunks, [&](std::size_t i) { std::sort(first + bounds[i], first + bounds[i + 1], comp); });
+
+    std::allocator<T> alloc;
+    T *const buffer = alloc.allocate(n);
+    // merge every pair of runs of width chunks from src to dst, each pair in pieces
+    const auto round = [&]<bool Construct>(auto src, auto dst, std::size_t width) {
+        const std::size_t pairs = (chunks + 2 * width - 1) / (2 * width);
+        const std::size_t pieces = std::max<std::size_t>(1, chunks / pairs);
+        pool.parallel_for(pairs * pieces, [&](std::size_t task) {
+            const std::size_t p = task / pieces;
+            const std::size_t piece = task % pieces;
+            const std::size_t lo = bounds[p * 2 * width];
+            const std::size_t mid = bounds[std::min(p * 2 * width + width, chunks)];
+            const std::size_t hi = bounds[std::min(p * 2 * width + 2 * width, chunks)];
+            // output positions [k0, k1) of this pair, and where they come from in each run
+            const std::size_t k0 = (hi - lo) * piece / pieces;
+            const std::size_t k1 = (hi - lo) * (piece + 1) / pieces;
+            const std::size_t i0 = sorted_detail::co_rank(k0, src + lo, mid - lo, src + mid, hi - mid, comp);
+            const std::size_t i1 = sorted_detail::co_rank(k1, src + lo, mid - lo, src + mid, hi - mid, comp);
+            sorted_detail::merge_move<Construct>(src + lo + i0, src + lo + i1, src + mid + (k0 - i0), src + mid + (k1 - i1),
+                                                 dst + lo + k0, comp);
+        });
+    };
+    // the first round constructs the buffer's elements, after that they are assigned
+    round.template operator()<true>(first, buffer, 1);
+    bool in_buffer = true;
+    for (std::size_t width = 2; width < chunks; width *= 2)
+    {
+        if (in_buffer)
+            round.template operator()<false>(buffer, first, width);
+        else
+            round.template operator()<false>(first, buffer, width);
+        in_buffer = !in_buffer;
+    }
+    pool.parallel_for(chunks, [&](std::size_t i) {
+        if (in_buffer)
+            std::move(buffer + bounds[i], buffer + bounds[i + 1], first + bounds[i]);
+        std::destroy(buffer + bounds[i], buffer + bounds[i + 1]);
+    });
+    alloc.deallocate(buffer, n);
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+// LSD radix sort, for vectors of entries with an integral key.
+// One pass builds the histograms for every byte of the key, then each byte is a stable scatter from
+// one buffer to the other (ping-pong). Bytes that are the same in every key are skipped, so
+// 0..16M int keys take 3 passes, not 4. Elements are moved, never copied, and there are no compares,
+// so it beats std::sort on the big vectors, where std::sort is mostly waiting on mispredicts.
+
+// below this std::sort wins, the histograms and second buffer aren't free
+inline constexpr std::size_t radix_sort_cutoff = 1 << 11;
+
+template<class Key>
+inline constexpr bool radix_sortable = std::is_integral_v<Key> && !std::is_same_v<Key, bool>;
+
+// ascending order only, any other ordering has to use a comparison sort
+template<class Key, class Compare>
+inline constexpr bool radix_sort_applies = radix_sortable<Key> &&
+    (std::is_same_v<Compare, std::less<Key>> || std::is_same_v<Compare, std::less<>>);
+
+// stable sort of v by key_of(element), ping-ponging with buffer.
+// buffer's storage is reused (it is resized, not reallocated, if it is big enough), and the
+// sorted result may end up swapped into v from it, so pass the same buffer back next time.
+// Precondition: the element type is default constructible (for the second buffer)
+template<class Vector, class KeyOf>
+void radix_sort(Vector &v, KeyOf key_of, Vector &buffer)
+{
+    using Key = std::remove_cvref_t<decltype(key_of(v.front()))>;
+    using Bits = std::make_unsigned_t<Key>;
+    constexpr unsigned passes = sizeof(Key);
+    const std::size_t n = v.size();
+    if (n < 2)
+        return;
+    // flip the sign bit so negative keys order before positive ones
+    const auto bits = [&](const auto &elem) {
+        Bits b = Bits(key_of(elem));
+        if constexpr (std::is_signed_v<Key>)
+            b ^= Bits(1) << (8 * sizeof(Key) - 1);
+        return b;
+    };
+
+    std::array<std::array<std::size_t, 256>, passes> counts{};
+    for (const auto &elem : v)
+    {
+        const Bits b = bits(elem);
+        for (unsigned p = 0; p < passes; ++p)
+            ++counts[p][(b >> (8 * p)) & 0xff];
+    }
+
+    buffer.resize(n);
+    Vector *src = &v;
+    Vector *dst = &buffer;
+    for (unsigned p = 0; p < passes; ++p)
+    {
+        auto &count = counts[p];
+        if (count[(bits(src->front()) >> (8 * p)) & 0xff] == n)
+            continue;
+        std::size_t offset = 0;
+        for (auto &c : count)
+            offset += std::exchange(c, offset);
+        for (auto &elem : *src)
+            (*dst)[count[(bits(elem) >> (8 * p)) & 0xff]++] = std::move(elem);
+        std::swap(src, dst);
+    }
+    if (src != &v)
+        v.swap(buffer);
+}
+
+template<class Vector, class KeyOf>
+void radix_sort(Vector &v, KeyOf key_of)
+{
+    Vector buffer(v.get_allocator());
+    radix_sort(v, key_of, buffer);
+}
@@ -0,0 +1,202 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+#include "thread_pool.hpp"
+// A sorted vector split by key range into shards, one sorted_vector each, so a batch is many small
+// memmoves and sorts that run side by side on a thread_pool, instead of one big one on one core.
+// Shard i holds the keys in [bounds[i - 1], bounds[i]), the first and last shards are open ended.
+// A batch is partitioned by shard (a binary search on the bounds per element), then every shard
+// that got something applies its part in parallel, each with its own scratch buffers.
+//
+// Rebalancing: when a shard grows past twice the average size it is split at its median, and the
+// adjacent pair with the fewest elements between them is merged, so the shard count stays fixed.
+// Both are O(shard size) moves, nothing else is touched.
+
+template<class Key, class Value, class Compare = std::less<Key>>
+class sharded_sorted_vector
+{
+public:
+    using shard_type = sorted_vector<Key, Value, Compare>;
+    using key_type = Key;
+    using value_type = typename shard_type::value_type;
+    using size_type = typename shard_type::size_type;
+
+    // below this average shard size skew doesn't matter, and isn't corrected
+    static constexpr size_type min_rebalance_size = 1024;
+
+    // split initial into shard_count shards of (nearly) equal size
+    sharded_sorted_vector(shard_type initial, thread_pool &pool, size_type shard_count = 0)
+        : pool(pool), comp(initial.key_comp())
+    {
+        if (shard_count == 0)
+            shard_count = 4 * pool.size();
+        auto entries = std::move(initial).extract();
+        const size_type n = entries.size();
+        for (size_type i = 0; i < shard_count; ++i)
+        {
+            const auto first = entries.begin() + n * i / shard_count;
+            const auto last = entries.begin() + n * (i + 1) / shard_count;
+            if (i > 0)
+                bounds.push_back(first != entries.end() ? first->k : (bounds.empty() ? Key{} : bounds.back()));
+            shards.emplace_back(sorted_unique, typename shard_type::container_type(std::make_move_iterator(first), std::make_move_iterator(last)), comp);
+        }
+        work.resize(shards.size());
+    }
+
+    size_type size() const noexcept
+    {
+        size_type retval = 0;
+        for (const auto &shard : shards)
+            retval += shard.size();
+        return retval;
+    }
+    bool empty() const noexcept { return size() == 0; }
+    size_type shard_count() const noexcept { return shards.size(); }
+    const shard_type &shard(size_type i) const noexcept { return shards[i]; }
+
+    // nullptr if not present
+    const value_type *find(const Key &key) const
+    {
+        const shard_type &shard = shards[shard_for(key)];
+        const auto found = shard.find(key);
+        return found == shard.end() ? nullptr : &*found;
+    }
+    bool contains(const Key &key) const { return find(key) != nullptr; }
+
+    // calls fn(entry) for every element, in key order
+    template<class Fn>
+    void for_each(Fn &&fn) const
+    {
+        for (const auto &shard : shards)
+            for (const auto &entry : shard)
+                fn(entry);
+    }
+
+    bool insert(value_type value)
+    {
+        const bool retval = shards[shard_for(value.k)].insert(std::move(value)).second;
+        rebalance();
+        return retval;
+    }
+    size_type erase(const Key &key) { return shards[shard_for(key)].erase(key); }
+
+    /*
+    batch_insert:
+     keys that are already present are not replaced (same as std::map::insert)
+     O(k log s) to partition, then each shard sorts and merges its own part, in parallel
+    */
+    void batch_insert(std::vector<value_type> selection)
+    {
+        std::vector<std::vector<value_type>> parts(shards.size());
+        for (auto &value : selection)
+            parts[shard_for(value.k)].push_back(std::move(value));
+        pool.parallel_for(shards.size(), [&](std::size_t i) {
+            if (!parts[i].empty())
+                shards[i].batch_insert(std::move(parts[i]), work[i]);
+        });
+        rebalance();
+    }
+
+    /*
+    batch_erase:
+     keys that aren't present are ignored. returns the number of elements removed
+    */
+    size_type batch_erase(std::span<const Key> selection)
+    {
+        std::vector<std::vector<Key>> parts(shards.size());
+        for (const Key &key : selection)
+            parts[shard_for(key)].push_back(key);
+        std::vector<size_type> erased(shards.size());
+        pool.parallel_for(shards.size(), [&](std::size_t i) {
+            if (!parts[i].empty())
+                erased[i] = shards[i].batch_erase(parts[i], work[i]);
+        });
+        rebalance();
+        return std::accumulate(erased.begin(), erased.end(), size_type(0));
+    }
+
+    // the element for each key (nullptr if missing), in the order of keys
+    std::vector<const value_type *> find_many(std::span<const Key> keys) const
+    {
+        // positions in keys, grouped by shard
+        std::vector<std::vector<size_type>> parts(shards.size());
+        for (size_type i = 0; i < keys.size(); ++i)
+            parts[shard_for(keys[i])].push_back(i);
+        std::vector<const value_type *> retval(keys.size());
+        pool.parallel_for(shards.size(), [&](std::size_t s) {
+            for (const size_type i : parts[s])
+            {
+                const auto found = shards[s].find(keys[i]);
+                retval[i] = found == shards[s].end() ? nullptr : &*found;
+            }
+        });
+        return retval;
+    }
+
+private:
+    size_type shard_for(const Key &key) const
+    {
+        return std::upper_bound(bounds.begin(), bounds.end(), key, comp) - bounds.begin();
+    }
+
+    void rebalance()
+    {
+        if (shards.size() < 2)
+            return;
+        const size_type average = size() / shards.size();
+        if (average < min_rebalance_size)
+            return;
+        for (;;)
+        {
+            const auto biggest = std::max_element(shards.begin(), shards.end(),
+                                                  [](const shard_type &a, const shard_type &b) { return a.size() < b.size(); });
+            if (biggest->size() <= 2 * average)
+                return;
+            split(biggest - shards.begin());
+            merge_smallest_pair();
+        }
+    }
+
+    // shard i becomes two, at its median
+    void split(size_type i)
+    {
+        auto entries = std::move(shards[i]).extract();
+        const auto middle = entries.begin() + entries.size() / 2;
+        const Key bound = middle->k;
+        typename shard_type::container_type upper(std::make_move_iterator(middle), std::make_move_iterator(entries.end()));
+        entries.erase(middle, entries.end());
+        shards[i] = shard_type{sorted_unique, std::move(entries), comp};
+        shards.insert(shards.begin() + i + 1, shard_type{sorted_unique, std::move(upper), comp});
+        bounds.insert(bounds.begin() + i, bound);
+        work.emplace_back();
+    }
+
+    void merge_smallest_pair()
+    {
+        size_type best = 0;
+        for (size_type i = 1; i + 1 < shards.size(); ++i)
+            if (shards[i].size() + shards[i + 1].size() < shards[best].size() + shards[best + 1].size())
+                best = i;
+        // the ranges don't overlap, so the merge is an append
+        auto entries = std::move(shards[best]).extract();
+        for (auto &entry : std::move(shards[best + 1]).extract())
+            entries.push_back(std::move(entry));
+        shards[best] = shard_type{sorted_unique, std::move(entries), comp};
+        shards.erase(shards.begin() + best + 1);
+        bounds.erase(bounds.begin() + best);
+        work.pop_back();
+    }
+
+    thread_pool &pool;
+    [[no_unique_address]] Compare comp;
+    std::vector<shard_type> shards;
+    std::vector<Key> bounds; // shards.size() - 1 splitting keys
+    std::vector<typename shard_type::scratch> work; // one per shard, reused between batches
+};
@@ -0,0 +1,210 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SORTED_VECTOR_X86 1
+#endif
+// lower_bound kernels for arithmetic keys.
+// std::lower_bound with a comparator compiles to a branch per probe, and the branch is a coin toss,
+// so every level costs a mispredict on top of the cache miss. These kernels:
+//  - narrow the range with a branchless (cmov) binary search, prefetching both possible next midpoints
+//  - once the range is down to finish_width elements, count the keys below the target with a
+//    k-ary SIMD compare (AVX2 or SSE), instead of 4 more dependent probes
+// The keys don't have to be contiguous, they can be a member of a bigger struct (stride is in bytes),
+// which is how sorted_vector uses them. The SIMD path is for 32/64 bit signed integers, other
+// arithmetic types get the branchless search with a scalar finish.
+// The instruction set is picked at runtime (cpuid), the build doesn't need -mavx2.
+
+namespace simd_search
+{
+enum class level { scalar, sse, avx2 };
+
+// keys counted by the final compare. 16 x int32 is one cache line when contiguous
+inline constexpr std::size_t finish_width = 16;
+
+template<class T>
+inline constexpr bool simd_key = std::is_integral_v<T> && std::is_signed_v<T> && (sizeof(T) == 4 || sizeof(T) == 8);
+
+// keys for which sorted_vector can use these kernels in place of std::lower_bound
+template<class Key, class Compare>
+inline constexpr bool accelerated = std::is_arithmetic_v<Key> &&
+    (std::is_same_v<Compare, std::less<Key>> || std::is_same_v<Compare, std::less<>>);
+
+template<class T>
+[[gnu::always_inline]] inline T key_at(const std::byte *first, std::size_t stride, std::size_t i)
+{
+    return *reinterpret_cast<const T *>(first + i * stride);
+}
+
+// Branchless binary search, down to a window of no more than finish_width keys.
+// returns the start of a finish_width window that holds the answer
+// Precondition: n >= finish_width
+template<class T>
+[[gnu::always_inline]] inline std::size_t narrow(const std::byte *first, std::size_t n, std::size_t stride, T key)
+{
+    const std::size_t total = n;
+    std::size_t base = 0;
+    while (n > finish_width)
+    {
+        const std::size_t half = n / 2;
+        const std::size_t next = (n - half) / 2;
+        __builtin_prefetch(first + (base + next) * stride);
+        __builtin_prefetch(first + (base + half + next) * stride);
+        base = (key_at<T>(first, stride, base + half) < key) ? base + half : base;
+        n -= half;
+    }
+    // the answer is in [base, base + n]. Everything before base is less than key, so any window
+    // that covers [base, base + n) gives the answer by counting, slide it back if it would overrun
+    return std::min(base, total - finish_width);
+}
+
+template<class T>
+inline std::size_t count_less_scalar(const std::byte *first, std::size_t n, std::size_t stride, T key)
+{
+    std::size_t retval = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        retval += key_at<T>(first, stride, i) < key;
+    return retval;
+}
+
+template<class T>
+std::size_t lower_bound_scalar(const std::byte *first, std::size_t n, std::size_t stride, T key)
+{
+    if (n < finish_width)
+        return count_less_scalar(first, n, stride, key);
+    const std::size_t window = narrow(first, n, stride, key);
+    return window + count_less_scalar(first + window * stride, finish_width, stride, key);
+}
+
+#ifdef SORTED_VECTOR_X86
+// count of keys < key in finish_width keys starting at first
+template<class T>
+[[gnu::target("avx2")]] inline unsigned count_less_avx2(const std::byte *first, std::size_t stride, T key)
+{
+    unsigned mask = 0;
+    if constexpr (sizeof(T) == 4)
+    {
+        const __m256i k = _mm256_set1_epi32(key);
+        for (std::size_t i = 0; i < finish_width; i += 8)
+        {
+            __m256i v;
+            if (stride == sizeof(T))
+                v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + i * stride));
+            else
+            {
+                const int s = static_cast<int>(stride);
+                const __m256i offsets = _mm256_setr_epi32(0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+                v = _mm256_i32gather_epi32(reinterpret_cast<const int *>(first + i * stride), offsets, 1);
+            }
+            mask |= unsigned(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v)))) << i;
+        }
+    }
+    else
+    {
+        const __m256i k = _mm256_set1_epi64x(key);
+        for (std::size_t i = 0; i < finish_width; i += 4)
+        {
+            __m256i v;
+            if (stride == sizeof(T))
+                v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + i * stride));
+            else
+            {
+                const int s = static_cast<int>(stride);
+                const __m128i offsets = _mm_setr_epi32(0, s, 2 * s, 3 * s);
+                v = _mm256_i32gather_epi64(reinterpret_cast<const long long *>(first + i * stride), offsets, 1);
+            }
+            mask |= unsigned(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v)))) << i;
+        }
+    }
+    return __builtin_popcount(mask);
+}
+
+// no gather in SSE, so strided keys use the scalar count
+template<class T>
+[[gnu::target("sse4.2")]] inline unsigned count_less_sse(const std::byte *first, std::size_t stride, T key)
+{
+    if (stride != sizeof(T))
+        return count_less_scalar(first, finish_width, stride, key);
+    unsigned mask = 0;
+    if constexpr (sizeof(T) == 4)
+    {
+        const __m128i k = _mm_set1_epi32(key);
+        for (std::size_t i = 0; i < finish_width; i += 4)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + i * stride));
+            mask |= unsigned(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(k, v)))) << i;
+        }
+    }
+    else
+    {
+        const __m128i k = _mm_set1_epi64x(key);
+        for (std::size_t i = 0; i < finish_width; i += 2)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first + i * stride));
+            mask |= unsigned(_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(k, v)))) << i;
+        }
+    }
+    return __builtin_popcount(mask);
+}
+
+template<class T>
+[[gnu::target("avx2")]] std::size_t lower_bound_avx2(const std::byte *first, std::size_t n, std::size_t stride, T key)
+{
+    if (n < finish_width)
+        return count_less_scalar(first, n, stride, key);
+    const std::size_t window = narrow(first, n, stride, key);
+    return window + count_less_avx2(first + window * stride, stride, key);
+}
+
+template<class T>
+[[gnu::target("sse4.2")]] std::size_t lower_bound_sse(const std::byte *first, std::size_t n, std::size_t stride, T key)
+{
+    if (n < finish_width)
+        return count_less_scalar(first, n, stride, key);
+    const std::size_t window = narrow(first, n, stride, key);
+    return window + count_less_sse(first + window * stride, stride, key);
+}
+#endif
+
+// best level this cpu supports
+inline level best_level()
+{
+#ifdef SORTED_VECTOR_X86
+    static const level best = __builtin_cpu_supports("avx2")     ? level::avx2
+                              : __builtin_cpu_supports("sse4.2") ? level::sse
+                                                                 : level::scalar;
+    return best;
+#else
+    return level::scalar;
+#endif
+}
+
+// lower_bound using the given kernel, as an index into the n keys.
+// Precondition: lvl is no better than best_level()
+template<class T>
+std::size_t lower_bound(level lvl, const T *first, std::size_t n, std::size_t stride, T key)
+{
+    const auto bytes = reinterpret_cast<const std::byte *>(first);
+#ifdef SORTED_VECTOR_X86
+    if constexpr (simd_key<T>)
+    {
+        if (lvl == level::avx2)
+            return lower_bound_avx2(bytes, n, stride, key);
+        if (lvl == level::sse)
+            return lower_bound_sse(bytes, n, stride, key);
+    }
+#endif
+    return lower_bound_scalar(bytes, n, stride, key);
+}
+
+// lower_bound using the best kernel for this cpu
+template<class T>
+std::size_t lower_bound(const T *first, std::size_t n, std::size_t stride, T key)
+{
+    return lower_bound(best_level(), first, n, stride, key);
+}
+} // simd_search
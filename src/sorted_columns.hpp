@@ -0,0 +1,300 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+// Structure-of-arrays version of sorted_vector: the keys live in one array and the values in a
+// parallel one. A search only ever touches the key column, so for sorted_vector<int, std::string>
+// a cache line holds 16 keys instead of less than 2 entries, and the SIMD kernel can use plain
+// loads instead of gathers. Every mutation moves both columns with the same permutation.
+// Iterators give a proxy ({k, v} references), so it->k / it->v read the same as sorted_vector.
+
+template<class Key, class Value, class Compare = std::less<Key>,
+         class KeyAllocator = std::allocator<Key>, class ValueAllocator = std::allocator<Value>>
+class sorted_columns
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = sorted_entry<Key, Value>;
+    using key_compare = Compare;
+    using key_container_type = std::vector<Key, KeyAllocator>;
+    using value_container_type = std::vector<Value, ValueAllocator>;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+
+    template<bool IsConst>
+    class basic_iterator
+    {
+        using owner = std::conditional_t<IsConst, const sorted_columns, sorted_columns>;
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = sorted_columns::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = sorted_entry<const Key &, std::conditional_t<IsConst, const Value &, Value &>>;
+        struct pointer
+        {
+            reference ref;
+            const reference *operator->() const noexcept { return &ref; }
+        };
+
+        basic_iterator() = default;
+        basic_iterator(owner *c, size_type i) noexcept : c(c), i(i) {}
+        operator basic_iterator<true>() const noexcept requires(!IsConst) { return {c, i}; }
+
+        reference operator*() const noexcept { return {c->key_column[i], c->value_column[i]}; }
+        pointer operator->() const noexcept { return {**this}; }
+        reference operator[](difference_type n) const noexcept { return *(*this + n); }
+        size_type index() const noexcept { return i; }
+
+        basic_iterator &operator++() noexcept { ++i; return *this; }
+        basic_iterator &operator--() noexcept { --i; return *this; }
+        basic_iterator operator++(int) noexcept { auto retval = *this; ++i; return retval; }
+        basic_iterator operator--(int) noexcept { auto retval = *this; --i; return retval; }
+        basic_iterator &operator+=(difference_type n) noexcept { i += n; return *this; }
+        basic_iterator &operator-=(difference_type n) noexcept { i -= n; return *this; }
+        friend basic_iterator operator+(basic_iterator it, difference_type n) noexcept { return it += n; }
+        friend basic_iterator operator+(difference_type n, basic_iterator it) noexcept { return it += n; }
+        friend basic_iterator operator-(basic_iterator it, difference_type n) noexcept { return it -= n; }
+        friend difference_type operator-(const basic_iterator &a, const basic_iterator &b) noexcept
+        {
+            return difference_type(a.i) - difference_type(b.i);
+        }
+        friend bool operator==(const basic_iterator &a, const basic_iterator &b) noexcept { return a.i == b.i; }
+        friend auto operator<=>(const basic_iterator &a, const basic_iterator &b) noexcept { return a.i <=> b.i; }
+
+    private:
+        owner *c{nullptr};
+        size_type i{0};
+    };
+    using iterator = basic_iterator<false>;
+    using const_iterator = basic_iterator<true>;
+
+    sorted_columns() = default;
+    explicit sorted_columns(const Compare &comp) : comp(comp) {}
+
+    // bulk construction, from unsorted entries. Sorted as entries, then split into the columns
+    // if keys are duplicated, which of the duplicates is kept is unspecified
+    explicit sorted_columns(std::vector<value_type> unsorted, const Compare &comp = Compare())
+        : comp(comp)
+    {
+        sorted_detail::sort_entries(unsorted, comp);
+        key_column.reserve(unsorted.size());
+        value_column.reserve(unsorted.size());
+        for (auto &entry : unsorted)
+        {
+            if (!key_column.empty() && !comp(key_column.back(), entry.k))
+                continue;
+            key_column.push_back(std::move(entry.k));
+            value_column.push_back(std::move(entry.v));
+        }
+    }
+
+    iterator begin() noexcept { return {this, 0}; }
+    iterator end() noexcept { return {this, size()}; }
+    const_iterator begin() const noexcept { return {this, 0}; }
+    const_iterator end() const noexcept { return {this, size()}; }
+    iterator nth(size_type n) noexcept { return {this, n}; }
+    const_iterator nth(size_type n) const noexcept { return {this, n}; }
+
+    bool empty() const noexcept { return key_column.empty(); }
+    size_type size() const noexcept { return key_column.size(); }
+    void reserve(size_type n)
+    {
+        key_column.reserve(n);
+        value_column.reserve(n);
+    }
+    void clear() noexcept
+    {
+        key_column.clear();
+        value_column.clear();
+    }
+
+    const key_container_type &keys() const noexcept { return key_column; }
+    const value_container_type &values() const noexcept { return value_column; }
+    key_compare key_comp() const { return comp; }
+
+    // lookup, only ever reads the key column
+    iterator lower_bound(const Key &key) { return {this, search(key)}; }
+    const_iterator lower_bound(const Key &key) const { return {this, search(key)}; }
+    iterator upper_bound(const Key &key)
+    {
+        return {this, size_type(std::upper_bound(key_column.begin(), key_column.end(), key, comp) - key_column.begin())};
+    }
+    const_iterator upper_bound(const Key &key) const
+    {
+        return {this, size_type(std::upper_bound(key_column.begin(), key_column.end(), key, comp) - key_column.begin())};
+    }
+    iterator find(const Key &key)
+    {
+        const size_type found = search(key);
+        return {this, (found != size() && !comp(key, key_column[found])) ? found : size()};
+    }
+    const_iterator find(const Key &key) const
+    {
+        const size_type found = search(key);
+        return {this, (found != size() && !comp(key, key_column[found])) ? found : size()};
+    }
+    bool contains(const Key &key) const { return find(key) != end(); }
+    size_type count(const Key &key) const { return contains(key) ? 1 : 0; }
+    // positions of a batch of keys (size() for the missing ones), in the order they were asked for
+    std::vector<size_type> find_many(std::span<const Key> queries) const
+    {
+        std::vector<size_type> retval(queries.size());
+        std::vector<size_type> order;
+        sorted_detail::find_many(key_column.begin(), key_column.end(), queries, retval.data(), comp, comp, order);
+        return retval;
+    }
+    std::pair<const_iterator, const_iterator> equal_range(const Key &key) const
+    {
+        const size_type found = search(key);
+        const size_type last = (found != size() && !comp(key, key_column[found])) ? found + 1 : found;
+        return {nth(found), nth(last)};
+    }
+
+    // single element modifiers. O(n) in both columns
+    std::pair<iterator, bool> insert(value_type value)
+    {
+        const size_type found = search(value.k);
+        if (found != size() && !comp(value.k, key_column[found]))
+            return {nth(found), false};
+        key_column.insert(key_column.begin() + found, std::move(value.k));
+        value_column.insert(value_column.begin() + found, std::move(value.v));
+        return {nth(found), true};
+    }
+    iterator erase(const_iterator pos)
+    {
+        key_column.erase(key_column.begin() + pos.index());
+        value_column.erase(value_column.begin() + pos.index());
+        return nth(pos.index());
+    }
+    size_type erase(const Key &key)
+    {
+        const auto found = find(key);
+        if (found == end())
+            return 0;
+        erase(found);
+        return 1;
+    }
+
+    /*
+    batch_insert:
+     as sorted_vector::batch_insert, the batch is sorted and merged backward into both columns
+     keys that are already present are not replaced
+    */
+    void batch_insert(std::vector<value_type> selection)
+    {
+        sorted_detail::sort_entries(selection, comp);
+        selection.erase(sorted_detail::drop_present_keys(selection.begin(), selection.end(), key_column.begin(),
+                                                         key_column.end(), comp, std::identity{}),
+                        selection.end());
+        if (selection.empty())
+            return;
+
+        const size_type n = size();
+        if constexpr (sorted_detail::fill_empty_slots<Key> && sorted_detail::fill_empty_slots<Value>)
+        {
+            key_column.resize(n + selection.size());
+            value_column.resize(n + selection.size());
+            // backward merge, as sorted_detail::merge_backward, the key column decides for both
+            size_type old_end = n;
+            size_type out = key_column.size();
+            for (auto it = selection.rbegin(); it != selection.rend(); ++it)
+            {
+                const size_type pos = sorted_detail::gallop_lower_bound_backward(key_column.begin(), key_column.begin() + old_end, it->k, comp) - key_column.begin();
+                std::move_backward(key_column.begin() + pos, key_column.begin() + old_end, key_column.begin() + out);
+                std::move_backward(value_column.begin() + pos, value_column.begin() + old_end, value_column.begin() + out);
+                out -= old_end - pos + 1;
+                key_column[out] = std::move(it->k);
+                value_column[out] = std::move(it->v);
+                old_end = pos;
+            }
+        }
+        else
+        {
+            // can't make empty slots to merge into, merge forward into new columns instead. Every
+            // element is move constructed, so allocator-aware ones keep their allocator
+            key_container_type keys(key_column.get_allocator());
+            value_container_type values(value_column.get_allocator());
+            keys.reserve(n + selection.size());
+            values.reserve(n + selection.size());
+            size_type i = 0;
+            for (auto &entry : selection)
+            {
+                for (; i < n && comp(key_column[i], entry.k); ++i)
+                {
+                    keys.push_back(std::move(key_column[i]));
+                    values.push_back(std::move(value_column[i]));
+                }
+                keys.push_back(std::move(entry.k));
+                values.push_back(std::move(entry.v));
+            }
+            std::move(key_column.begin() + i, key_column.end(), std::back_inserter(keys));
+            std::move(value_column.begin() + i, value_column.end(), std::back_inserter(values));
+            key_column = std::move(keys);
+            value_column = std::move(values);
+        }
+    }
+
+    /*
+    batch_erase:
+     as sorted_vector::batch_erase, one order preserving pass over both columns.
+     Keys that aren't present are ignored. returns the number of elements removed
+    */
+    size_type batch_erase(std::vector<Key> selection)
+    {
+        std::sort(selection.begin(), selection.end(), comp);
+        size_type in = 0, out = 0, cursor = 0;
+        for (const Key &key : selection)
+        {
+            cursor = sorted_detail::gallop_lower_bound(key_column.begin() + cursor, key_column.end(), key, comp) - key_column.begin();
+            if (cursor == size() || comp(key, key_column[cursor]))
+                continue;
+            out = (out == in) ? cursor : slide(in, cursor, out);
+            in = ++cursor;
+        }
+        if (out == in)
+            return 0;
+        out = slide(in, size(), out);
+        const size_type retval = size() - out;
+        key_column.resize(out);
+        value_column.resize(out);
+        return retval;
+    }
+
+    // remove every element in the key range [lo, hi)
+    size_type erase_range(const Key &lo, const Key &hi)
+    {
+        const size_type first = search(lo);
+        const size_type last = sorted_detail::gallop_lower_bound(key_column.begin() + first, key_column.end(), hi, comp) - key_column.begin();
+        key_column.erase(key_column.begin() + first, key_column.begin() + last);
+        value_column.erase(value_column.begin() + first, value_column.begin() + last);
+        return last - first;
+    }
+
+private:
+    size_type search(const Key &key) const
+    {
+        if constexpr (simd_search::accelerated<Key, Compare>)
+            return empty() ? 0 : simd_search::lower_bound(key_column.data(), size(), sizeof(Key), key);
+        else
+            return std::lower_bound(key_column.begin(), key_column.end(), key, comp) - key_column.begin();
+    }
+
+    // move [first, last) down to out in both columns, returns the new out
+    size_type slide(size_type first, size_type last, size_type out)
+    {
+        std::move(key_column.begin() + first, key_column.begin() + last, key_column.begin() + out);
+        std::move(value_column.begin() + first, value_column.begin() + last, value_column.begin() + out);
+        return out + (last - first);
+    }
+
+    key_container_type key_column;
+    value_container_type value_column;
+    [[no_unique_address]] Compare comp;
+};
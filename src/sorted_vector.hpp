@@ -0,0 +1,573 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "parallel_sort.hpp"
+#include "radix_sort.hpp"
+#include "simd_lower_bound.hpp"
+// A sorted-vector: a drop in for std::map for the (very common) case where the container is built
+// once, searched a lot, and mutated in batches. Elements live in one contiguous block, so lookups
+// are a binary search over memory the prefetcher understands, and there is no per-node allocation.
+// Single inserts/erases are O(n) (a memmove), so prefer the batch functions when mutating.
+
+// Key/value pair stored in the vector. Plain aggregate so it can be brace-initialised like the
+// old Elem{k, v}. Don't change k through an iterator, it will break the ordering.
+template<class Key, class Value>
+struct sorted_entry
+{
+    Key k;
+    Value v;
+};
+
+namespace sorted_detail
+{
+// galloping (exponential) search: lower_bound that probes first[0], first[1], first[3], first[7]...
+// Costs O(log d) where d is the distance to the answer, so walking a sorted batch through a sorted
+// vector is O(k log(n/k)) rather than O(k log n) or O(n).
+template<class It, class T, class Comp>
+It gallop_lower_bound(It first, It last, const T &key, Comp comp)
+{
+    const auto n = last - first;
+    decltype(last - first) bound = 1;
+    while (bound <= n && comp(first[bound - 1], key))
+        bound *= 2;
+    return std::lower_bound(first + bound / 2, first + std::min(bound, n), key, comp);
+}
+
+// as above, but starts from the back, probing last[-1], last[-2], last[-4]...
+template<class It, class T, class Comp>
+It gallop_lower_bound_backward(It first, It last, const T &key, Comp comp)
+{
+    const auto n = last - first;
+    decltype(last - first) bound = 1;
+    while (bound <= n && !comp(last[-bound], key))
+        bound *= 2;
+    return std::lower_bound(last - std::min(bound, n), last - bound / 2, key, comp);
+}
+
+// Merge the sorted run [first, last) into the front of dest, which holds a sorted run of n elements
+// followed by (last - first) slots to be overwritten. Works backward from the end of dest, so each
+// existing element is moved at most once and no temporary buffer is needed.
+// Precondition: no key in [first, last) equals a key in dest
+template<class Dest, class It, class Comp>
+void merge_backward(Dest &dest, typename Dest::size_type n, It first, It last, Comp comp)
+{
+    auto old_end = dest.begin() + n;
+    auto out = dest.end();
+    while (last != first)
+    {
+        --last;
+        const auto pos = gallop_lower_bound_backward(dest.begin(), old_end, last->k, comp);
+        out = std::move_backward(pos, old_end, out);
+        *--out = std::move(*last);
+        old_end = pos;
+    }
+}
+
+// The dedupe pass of a batch insert, once the batch [first, last) is sorted: drops the keys that are
+// repeated in the batch, or already in the sorted run [dest_first, dest_last), and packs the rest at
+// the front of the batch. key_of gives the key of a dest element. Returns the new end of the batch
+template<class It, class DestIt, class Comp, class KeyOf>
+It drop_present_keys(It first, It last, DestIt dest_first, DestIt dest_last, Comp comp, KeyOf key_of)
+{
+    const auto before = [&](const auto &elem, const auto &key) { return comp(key_of(elem), key); };
+    auto cursor = dest_first;
+    auto kept = first;
+    for (auto it = first; it != last; ++it)
+    {
+        if (kept != first && !comp(kept[-1].k, it->k))
+            continue;
+        cursor = gallop_lower_bound(cursor, dest_last, it->k, before);
+        if (cursor != dest_last && !comp(it->k, key_of(*cursor)))
+            continue;
+        if (kept != it)
+            *kept = std::move(*it);
+        ++kept;
+    }
+    return kept;
+}
+
+// True for values with an allocator that can differ between objects (std::pmr::string...).
+// Move assigning one of those into a default constructed value can copy it into the default
+// resource, so they skip the tricks that make empty slots and fill them (backward merge, radix sort).
+template<class T, class = void>
+struct stateful_allocator : std::false_type {};
+template<class T>
+struct stateful_allocator<T, std::void_t<typename T::allocator_type>>
+    : std::bool_constant<!std::allocator_traits<typename T::allocator_type>::is_always_equal::value> {};
+
+template<class T>
+inline constexpr bool fill_empty_slots = std::is_default_constructible_v<T> && !stateful_allocator<T>::value;
+
+// Entries too big (SomeHeavyWeight is ~1KB) or too expensive to move around freely. std::sort moves
+// each one O(log n) times, and the radix sort once per pass, so these are sorted indirectly instead.
+inline constexpr std::size_t indirect_sort_bytes = 128;
+template<class T>
+inline constexpr bool heavy_entry = sizeof(T) > indirect_sort_bytes || !std::is_nothrow_move_constructible_v<T>;
+
+// Reorder v so that v[i] becomes what was at v[perm[i]], moving each element once (plus one move per
+// cycle), by following the cycles of the permutation. perm is used up (left as the identity).
+template<class Vector, class Index>
+void apply_permutation(Vector &v, std::vector<Index> &perm)
+{
+    for (std::size_t i = 0; i < v.size(); ++i)
+    {
+        if (perm[i] == i)
+            continue;
+        auto held = std::move(v[i]);
+        std::size_t j = i;
+        for (;;)
+        {
+            const std::size_t from = std::exchange(perm[j], Index(j));
+            if (from == i)
+            {
+                v[j] = std::move(held);
+                break;
+            }
+            v[j] = std::move(v[from]);
+            j = from;
+        }
+    }
+}
+
+template<class Vector, class Compare>
+void sort_entries(Vector &v, Compare comp, Vector *radix_buffer = nullptr);
+
+// Sort (key, position) pairs instead (radix sorted too, for integral keys), then move every entry
+// straight to where it belongs
+template<class Vector, class Compare>
+void sort_entries_indirect(Vector &v, Compare comp)
+{
+    using Key = decltype(Vector::value_type::k);
+    std::vector<sorted_entry<Key, std::size_t>> order;
+    order.reserve(v.size());
+    for (std::size_t i = 0; i < v.size(); ++i)
+        order.push_back({v[i].k, i});
+    sort_entries(order, comp);
+    std::vector<std::size_t> perm;
+    perm.reserve(order.size());
+    for (const auto &entry : order)
+        perm.push_back(entry.v);
+    apply_permutation(v, perm);
+}
+
+// Sort a vector of entries by key. Integral keys in ascending order take the radix sort,
+// heavy entries an indirect sort, anything else is std::sort.
+// radix_buffer, if given, is the radix sort's second buffer, kept between calls to save allocating
+template<class Vector, class Compare>
+void sort_entries(Vector &v, Compare comp, Vector *radix_buffer)
+{
+    using entry = typename Vector::value_type;
+    using Key = decltype(entry::k);
+    if constexpr (heavy_entry<entry>)
+    {
+        if (v.size() > 1)
+            return sort_entries_indirect(v, comp);
+        return;
+    }
+    else if constexpr (radix_sort_applies<Key, Compare> && fill_empty_slots<entry> && fill_empty_slots<decltype(entry::v)>)
+    {
+        if (v.size() >= radix_sort_cutoff)
+        {
+            const auto key_of = [](const entry &e) { return e.k; };
+            return radix_buffer ? radix_sort(v, key_of, *radix_buffer) : radix_sort(v, key_of);
+        }
+    }
+    std::sort(v.begin(), v.end(), [&comp](const entry &a, const entry &b) { return comp(a.k, b.k); });
+}
+
+// Look up a batch of keys in [first, last), writing each query's position (or last - first if it is
+// missing) to out, in query order. The queries are visited in sorted order through an index
+// permutation, and each search gallops forward from the previous hit, so k random probes of
+// log n misses become a mostly forward scan: O(k log k + k log(n/k)).
+// order is working space, its capacity is reused
+template<class It, class Key, class Comp, class KeyComp, class SizeType>
+void find_many(It first, It last, std::span<const Key> queries, SizeType *out, Comp comp, KeyComp key_comp, std::vector<SizeType> &order)
+{
+    order.resize(queries.size());
+    std::iota(order.begin(), order.end(), SizeType(0));
+    std::sort(order.begin(), order.end(), [&](SizeType a, SizeType b) { return key_comp(queries[a], queries[b]); });
+    It cursor = first;
+    for (const SizeType q : order)
+    {
+        const Key &key = queries[q];
+        cursor = gallop_lower_bound(cursor, last, key, comp);
+        out[q] = (cursor != last && !comp(key, *cursor)) ? SizeType(cursor - first) : SizeType(last - first);
+    }
+}
+
+// lower_bound restricted to positions [first, last) of a sorted vector, as a position.
+// The search indexes narrow the range down, and leave the last few probes to this.
+// The SIMD kernel needs the entries in one array (sorted_vector), anything else with nth() and
+// random access iterators (sorted_columns, with its proxies) gets std::lower_bound
+template<class SortedVector, class Key, class Compare>
+std::size_t lower_bound_between(const SortedVector &sorted, std::size_t first, std::size_t last, const Key &key, Compare comp)
+{
+    if constexpr (simd_search::accelerated<Key, Compare> && std::contiguous_iterator<typename SortedVector::const_iterator>)
+    {
+        if (first == last)
+            return first;
+        return first + simd_search::lower_bound(&sorted.nth(first)->k, last - first, sizeof(typename SortedVector::value_type), key);
+    }
+    else
+        return std::lower_bound(sorted.nth(first), sorted.nth(last), key,
+                                [&comp](const auto &entry, const Key &k) { return comp(entry.k, k); }) - sorted.begin();
+}
+} // sorted_detail
+
+// tag type, used to adopt an already sorted container without re-sorting it
+struct sorted_unique_t { explicit sorted_unique_t() = default; };
+inline constexpr sorted_unique_t sorted_unique{};
+
+template<class Key, class Value, class Compare = std::less<Key>,
+         class Allocator = std::allocator<sorted_entry<Key, Value>>>
+class sorted_vector
+{
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = sorted_entry<Key, Value>;
+    using key_compare = Compare;
+    using allocator_type = Allocator;
+    using container_type = std::vector<value_type, Allocator>;
+    using size_type = typename container_type::size_type;
+    using difference_type = typename container_type::difference_type;
+    using iterator = typename container_type::iterator;
+    using const_iterator = typename container_type::const_iterator;
+
+    // Working space for the batch functions. Keep one around and pass it in, and once its buffers
+    // have grown to the batch size a steady stream of batches does no container or scratch
+    // allocation. Copying a value can still allocate (a std::string too long for its inline
+    // buffer), and the span overloads copy the batch, so for those values use the move-sink.
+    struct scratch
+    {
+        std::vector<Key> keys;
+        std::vector<value_type> entries;
+        std::vector<value_type> radix_buffer;
+        std::vector<size_type> order;
+    };
+
+    // compares two entries by key, or an entry against a bare key (either way around)
+    struct value_compare
+    {
+        Compare comp;
+        bool operator()(const value_type &a, const value_type &b) const { return comp(a.k, b.k); }
+        bool operator()(const value_type &a, const Key &b) const { return comp(a.k, b); }
+        bool operator()(const Key &a, const value_type &b) const { return comp(a, b.k); }
+    };
+
+    sorted_vector() = default;
+    explicit sorted_vector(const Compare &comp, const Allocator &alloc = Allocator())
+        : data(alloc), comp(comp) {}
+
+    // bulk construction, from an unsorted container.
+    // if keys are duplicated, which of the duplicates is kept is unspecified (same as std::flat_map)
+    explicit sorted_vector(container_type unsorted, const Compare &comp = Compare())
+        : data(std::move(unsorted)), comp(comp)
+    {
+        sorted_detail::sort_entries(data, comp);
+        remove_duplicates();
+    }
+
+    // as above, with the sort spread over a thread pool
+    sorted_vector(container_type unsorted, thread_pool &pool, const Compare &comp = Compare())
+        : data(std::move(unsorted)), comp(comp)
+    {
+        parallel_sort(data.begin(), data.end(), value_comp(), pool);
+        remove_duplicates();
+    }
+
+    template<class InputIt>
+    sorted_vector(InputIt first, InputIt last, const Compare &comp = Compare(), const Allocator &alloc = Allocator())
+        : sorted_vector(container_type(first, last, alloc), comp) {}
+
+    // Precondition: sorted is sorted by comp, with no duplicate keys
+    sorted_vector(sorted_unique_t, container_type sorted, const Compare &comp = Compare())
+        : data(std::move(sorted)), comp(comp) {}
+
+    iterator begin() noexcept { return data.begin(); }
+    iterator end() noexcept { return data.end(); }
+    const_iterator begin() const noexcept { return data.begin(); }
+    const_iterator end() const noexcept { return data.end(); }
+    const_iterator cbegin() const noexcept { return data.cbegin(); }
+    const_iterator cend() const noexcept { return data.cend(); }
+
+    // positional access (by rank, not by key)
+    iterator nth(size_type n) noexcept { return data.begin() + n; }
+    const_iterator nth(size_type n) const noexcept { return data.begin() + n; }
+
+    bool empty() const noexcept { return data.empty(); }
+    size_type size() const noexcept { return data.size(); }
+    size_type capacity() const noexcept { return data.capacity(); }
+    void reserve(size_type n) { data.reserve(n); }
+    void clear() noexcept { data.clear(); }
+
+    key_compare key_comp() const { return comp; }
+    value_compare value_comp() const { return value_compare{comp}; }
+    allocator_type get_allocator() const { return data.get_allocator(); }
+
+    // lookup. arithmetic keys with the default ordering use the branchless/SIMD kernels
+    iterator lower_bound(const Key &key) { return data.begin() + search(key); }
+    const_iterator lower_bound(const Key &key) const { return data.begin() + search(key); }
+    iterator upper_bound(const Key &key) { return std::upper_bound(data.begin(), data.end(), key, value_comp()); }
+    const_iterator upper_bound(const Key &key) const { return std::upper_bound(data.begin(), data.end(), key, value_comp()); }
+
+    iterator find(const Key &key)
+    {
+        const auto found = lower_bound(key);
+        return (found != end() && !comp(key, found->k)) ? found : end();
+    }
+    const_iterator find(const Key &key) const
+    {
+        const auto found = lower_bound(key);
+        return (found != end() && !comp(key, found->k)) ? found : end();
+    }
+    bool contains(const Key &key) const { return find(key) != end(); }
+    size_type count(const Key &key) const { return contains(key) ? 1 : 0; }
+
+    // positions of a batch of keys (size() for the missing ones), in the order they were asked for
+    std::vector<size_type> find_many(std::span<const Key> queries) const
+    {
+        std::vector<size_type> retval(queries.size());
+        std::vector<size_type> order;
+        sorted_detail::find_many(data.begin(), data.end(), queries, retval.data(), value_comp(), comp, order);
+        return retval;
+    }
+    // as above, allocation free. Precondition: out.size() == queries.size()
+    void find_many(std::span<const Key> queries, std::span<size_type> out, scratch &work) const
+    {
+        sorted_detail::find_many(data.begin(), data.end(), queries, out.data(), value_comp(), comp, work.order);
+    }
+
+    // keys are unique, so the range is either empty or one element, but found with a single search
+    std::pair<iterator, iterator> equal_range(const Key &key)
+    {
+        const auto found = lower_bound(key);
+        if (found != end() && !comp(key, found->k))
+            return {found, found + 1};
+        return {found, found};
+    }
+    std::pair<const_iterator, const_iterator> equal_range(const Key &key) const
+    {
+        const auto found = lower_bound(key);
+        if (found != end() && !comp(key, found->k))
+            return {found, found + 1};
+        return {found, found};
+    }
+
+    // every element with a key in [lo, hi). One search for lo, then a gallop from there for hi,
+    // so a short range costs one search, not two
+    std::ranges::subrange<iterator> range(const Key &lo, const Key &hi)
+    {
+        const auto first = lower_bound(lo);
+        return {first, sorted_detail::gallop_lower_bound(first, data.end(), hi, value_comp())};
+    }
+    std::ranges::subrange<const_iterator> range(const Key &lo, const Key &hi) const
+    {
+        const auto first = lower_bound(lo);
+        return {first, sorted_detail::gallop_lower_bound(first, data.end(), hi, value_comp())};
+    }
+
+    // single element modifiers. O(n), use the batch versions for anything more than a handful
+    std::pair<iterator, bool> insert(value_type value)
+    {
+        const auto found = lower_bound(value.k);
+        if (found != end() && !comp(value.k, found->k))
+            return {found, false};
+        return {data.insert(found, std::move(value)), true};
+    }
+    iterator erase(const_iterator pos) { return data.erase(pos); }
+    size_type erase(const Key &key)
+    {
+        const auto found = find(key);
+        if (found == end())
+            return 0;
+        data.erase(found);
+        return 1;
+    }
+
+    /*
+    batch_insert:
+     add a set of elements as a single op.
+     keys that are already present are not replaced (same as std::map::insert)
+     Only the batch is sorted, O(k log k) (or O(k) radix sorted for integral keys), it is then merged backward into the vector's spare capacity, O(n + k)
+    */
+    void batch_insert(std::vector<value_type> selection)
+    {
+        sorted_detail::sort_entries(selection, comp);
+        insert_sorted(selection.begin(), selection.end());
+    }
+    // move-sink, sorts the caller's vector in place, using work for the radix buffer
+    void batch_insert(std::vector<value_type> &&selection, scratch &work)
+    {
+        sorted_detail::sort_entries(selection, comp, &work.radix_buffer);
+        insert_sorted(selection.begin(), selection.end());
+    }
+    // copies the batch into work, and sorts it there. Each value is copied, which allocates if
+    // copying a value does
+    void batch_insert(std::span<const value_type> selection, scratch &work)
+    {
+        work.entries.assign(selection.begin(), selection.end());
+        sorted_detail::sort_entries(work.entries, comp, &work.radix_buffer);
+        insert_sorted(work.entries.begin(), work.entries.end());
+    }
+
+    /*
+    batch_erase:
+     remove a set of elements from a sorted vector as a single op, keeping the order.
+     Walks the sorted selection and the vector together, galloping over untouched spans, and
+     slides the survivors down in one pass. Keys that aren't present are ignored.
+     returns the number of elements removed
+    */
+    size_type batch_erase(std::vector<Key> selection)
+    {
+        std::sort(selection.begin(), selection.end(), comp);
+        return erase_sorted(selection);
+    }
+    // copies the keys into work to sort them
+    size_type batch_erase(std::span<const Key> selection, scratch &work)
+    {
+        work.keys.assign(selection.begin(), selection.end());
+        std::sort(work.keys.begin(), work.keys.end(), comp);
+        return erase_sorted(work.keys);
+    }
+    // Precondition: selection is sorted by comp
+    size_type batch_erase_sorted(std::span<const Key> selection) { return erase_sorted(selection); }
+
+    // remove every element in the key range [lo, hi). One search, and the tail moves down once
+    size_type erase_range(const Key &lo, const Key &hi)
+    {
+        const auto doomed = range(lo, hi);
+        const size_type retval = doomed.size();
+        data.erase(doomed.begin(), doomed.end());
+        return retval;
+    }
+
+    /*
+    insert_range:
+     splice in a block that is already sorted, with no repeated keys.
+     If the block falls in a gap between two existing keys (the usual case for a block of new
+     keys, appended ids, a reloaded partition...) it is one search and one tail move, O(log n + n - pos + k).
+     Otherwise it is merged, as batch_insert but without the sort.
+     keys that are already present are not replaced. returns the number of elements added
+    */
+    size_type insert_range(sorted_unique_t, std::vector<value_type> block)
+    {
+        if (block.empty())
+            return 0;
+        const auto pos = lower_bound(block.front().k);
+        if (pos == end() || comp(block.back().k, pos->k))
+        {
+            data.insert(pos, std::make_move_iterator(block.begin()), std::make_move_iterator(block.end()));
+            return block.size();
+        }
+        const size_type before = size();
+        insert_sorted(block.begin(), block.end());
+        return size() - before;
+    }
+
+    // remove every element matching pred, in one pass (as std::erase_if)
+    template<class Pred>
+    friend size_type erase_if(sorted_vector &vector, Pred pred)
+    {
+        const auto found = std::remove_if(vector.data.begin(), vector.data.end(), pred);
+        const size_type retval = vector.data.end() - found;
+        vector.data.erase(found, vector.data.end());
+        return retval;
+    }
+
+    // access to the underlying storage (as std::flat_map), leaves this empty
+    container_type extract() &&
+    {
+        container_type retval = std::move(data);
+        data.clear();
+        return retval;
+    }
+    // Precondition: sorted is sorted by comp, with no duplicate keys
+    void replace(container_type &&sorted) { data = std::move(sorted); }
+
+private:
+    // the body of batch_insert, once the batch is sorted. It is reordered and its elements moved from
+    template<class It>
+    void insert_sorted(It first, It last)
+    {
+        last = sorted_detail::drop_present_keys(first, last, data.begin(), data.end(), comp,
+                                                [](const value_type &entry) -> const Key & { return entry.k; });
+        const size_type count = last - first;
+        if (count == 0)
+            return;
+
+        const size_type n = data.size();
+        if (data.capacity() < n + count)
+            data.reserve(std::max(n + count, 2 * data.capacity()));
+        if constexpr (sorted_detail::fill_empty_slots<value_type> && sorted_detail::fill_empty_slots<Value>)
+        {
+            data.resize(n + count);
+            sorted_detail::merge_backward(data, n, first, last, value_comp());
+        }
+        else
+        {
+            // can't make empty slots to merge into, fall back to the library merge (which may allocate).
+            // it move constructs into its buffer, so allocator-aware values keep their allocator
+            data.insert(data.end(), std::make_move_iterator(first), std::make_move_iterator(last));
+            std::inplace_merge(data.begin(), data.begin() + n, data.end(), value_comp());
+        }
+    }
+
+    // the body of batch_erase, once the keys are sorted
+    size_type erase_sorted(std::span<const Key> selection)
+    {
+        iterator in = data.begin();     // first survivor not yet slid down
+        iterator out = data.begin();    // where it goes
+        iterator cursor = data.begin(); // where the next search starts
+        for (const Key &key : selection)
+        {
+            cursor = sorted_detail::gallop_lower_bound(cursor, data.end(), key, value_comp());
+            if (cursor == data.end() || comp(key, cursor->k))
+                continue;
+            // nothing has been removed yet, so the prefix is already in place
+            out = (out == in) ? cursor : std::move(in, cursor, out);
+            in = ++cursor;
+        }
+        return compact(in, out);
+    }
+
+    size_type search(const Key &key) const
+    {
+        if constexpr (simd_search::accelerated<Key, Compare>)
+        {
+            if (data.empty())
+                return 0;
+            return simd_search::lower_bound(&data.front().k, data.size(), sizeof(value_type), key);
+        }
+        else
+            return std::lower_bound(data.begin(), data.end(), key, value_comp()) - data.begin();
+    }
+
+    // everything before out is kept, [out, in) are the removed slots. slide the rest down
+    size_type compact(iterator in, iterator out)
+    {
+        if (out == in)
+            return 0;
+        out = std::move(in, data.end(), out);
+        const size_type retval = data.end() - out;
+        data.erase(out, data.end());
+        return retval;
+    }
+
+    void remove_duplicates()
+    {
+        const auto equal = [this](const value_type &a, const value_type &b) { return !comp(a.k, b.k) && !comp(b.k, a.k); };
+        data.erase(std::unique(data.begin(), data.end(), equal), data.end());
+    }
+
+    container_type data;
+    [[no_unique_address]] Compare comp;
+};
@@ -0,0 +1,65 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+// Interned strings, for sorted-vector values that repeat a lot (names, tags, the "0".."99" in the
+// timings). Each distinct string is stored once, in big blocks that never move, and the value in
+// the vector is a 4 byte handle instead of a 32 byte std::string. Sorting and erasing then move
+// 8 byte entries around, and building a table of 16M elements is 16M hash lookups rather than
+// 16M string constructions.
+// Strings are never removed, the pool only grows. Not thread safe.
+
+class string_pool
+{
+public:
+    struct handle
+    {
+        std::uint32_t id;
+        friend bool operator==(handle a, handle b) noexcept { return a.id == b.id; }
+    };
+
+    string_pool() = default;
+    string_pool(const string_pool &) = delete;
+    string_pool &operator=(const string_pool &) = delete;
+
+    handle intern(std::string_view s)
+    {
+        if (const auto found = lookup.find(s); found != lookup.end())
+            return {found->second};
+        const std::string_view stored = store(s);
+        const handle retval{std::uint32_t(views.size())};
+        views.push_back(stored);
+        lookup.emplace(stored, retval.id);
+        return retval;
+    }
+
+    std::string_view view(handle h) const noexcept { return views[h.id]; }
+    // number of distinct strings
+    std::size_t size() const noexcept { return views.size(); }
+
+private:
+    static constexpr std::size_t block_size = 64 * 1024;
+
+    // copy s somewhere it will never move
+    std::string_view store(std::string_view s)
+    {
+        if (used + s.size() > block_size)
+        {
+            blocks.push_back(std::make_unique<char[]>(std::max(block_size, s.size())));
+            used = 0;
+        }
+        char *dest = blocks.back().get() + used;
+        std::memcpy(dest, s.data(), s.size());
+        used += s.size();
+        return {dest, s.size()};
+    }
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    std::size_t used{block_size}; // of the last block, starts "full" so the first store makes one
+    std::vector<std::string_view> views;
+    std::unordered_map<std::string_view, std::uint32_t> lookup;
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+// Minimal fork-join pool for the parallel sorted-vector operations.
+// thread_pool(n) means n threads take part in a parallel_for: n - 1 workers, plus the caller.
+// The caller always works through the indices itself, so parallel_for can't deadlock even if it is
+// called from inside a task, it just gets less help.
+
+class thread_pool
+{
+public:
+    explicit thread_pool(unsigned threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (unsigned i = 1; i < threads; ++i)
+            workers.emplace_back([this] { work(); });
+    }
+    ~thread_pool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker : workers)
+            worker.join();
+    }
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    // number of threads that take part in a parallel_for, including the caller
+    unsigned size() const noexcept { return unsigned(workers.size()) + 1; }
+
+    // queue a task for a worker, no waiting. With no workers it runs immediately on the caller
+    void submit(std::function<void()> task)
+    {
+        if (workers.empty())
+            return task();
+        {
+            std::lock_guard lock(mutex);
+            tasks.push_back(std::move(task));
+        }
+        wake.notify_one();
+    }
+
+    // calls fn(i) for every i in [0, n), spread over the pool, and returns when they are all done
+    template<class Fn>
+    void parallel_for(std::size_t n, Fn &&fn)
+    {
+        if (n == 0)
+            return;
+        if (n == 1 || workers.empty())
+        {
+            for (std::size_t i = 0; i < n; ++i)
+                fn(i);
+            return;
+        }
+        // shared, as a helper may only get round to looking after we have returned
+        struct job
+        {
+            std::atomic<std::size_t> next{0};
+            std::size_t n;
+            std::function<void(std::size_t)> fn;
+            std::latch done;
+            job(std::size_t n, std::function<void(std::size_t)> fn) : n(n), fn(std::move(fn)), done(std::ptrdiff_t(n)) {}
+            void run()
+            {
+                for (std::size_t i = next++; i < n; i = next++)
+                {
+                    fn(i);
+                    done.count_down();
+                }
+            }
+        };
+        const auto shared = std::make_shared<job>(n, std::ref(fn));
+        const std::size_t helpers = std::min<std::size_t>(workers.size(), n - 1);
+        for (std::size_t i = 0; i < helpers; ++i)
+            submit([shared] { shared->run(); });
+        shared->run();
+        shared->done.wait();
+    }
+
+private:
+    void work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping{false};
+};
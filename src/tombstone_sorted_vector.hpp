@@ -0,0 +1,260 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <latch>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "sorted_vector.hpp"
+#include "thread_pool.hpp"
+// sorted_vector with tombstone deletes. erase() just sets a bit in a packed bitmap (one bit per
+// slot), so the hot path is a search and a bit-or, instead of an O(n) memmove. Lookups and
+// iteration skip the dead slots. Once the dead fraction passes the threshold the dead slots are
+// squeezed out in one pass, either inline, or on a background thread_pool worker if one was given.
+//
+// Background compaction: the worker copies the survivors (as of the moment it started) into a new
+// vector, while the owner carries on reading the old one. Erases made in the meantime set bits
+// on the old bitmap, and are remembered, then replayed as tombstones on the new vector when it is
+// swapped in. The swap happens in the next non-const call (or poll()), never behind a reader's back.
+// Inserts wait for a running compaction first, the worker needs the old vector to hold still.
+// Values must be copyable for the background mode.
+
+template<class Key, class Value, class Compare = std::less<Key>>
+class tombstone_sorted_vector
+{
+public:
+    using container_type = sorted_vector<Key, Value, Compare>;
+    using key_type = Key;
+    using value_type = typename container_type::value_type;
+    using size_type = typename container_type::size_type;
+
+    static constexpr double default_threshold = 0.25;
+
+    // iterates the live elements only
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = tombstone_sorted_vector::value_type;
+        using difference_type = std::ptrdiff_t;
+        using reference = const value_type &;
+        using pointer = const value_type *;
+
+        const_iterator() = default;
+        const_iterator(const tombstone_sorted_vector *c, size_type i) noexcept : c(c), i(i) {}
+        reference operator*() const noexcept { return *c->data.nth(i); }
+        pointer operator->() const noexcept { return &*c->data.nth(i); }
+        const_iterator &operator++() noexcept
+        {
+            i = c->next_alive(i + 1);
+            return *this;
+        }
+        const_iterator operator++(int) noexcept
+        {
+            auto retval = *this;
+            ++*this;
+            return retval;
+        }
+        friend bool operator==(const const_iterator &a, const const_iterator &b) noexcept { return a.i == b.i; }
+
+    private:
+        const tombstone_sorted_vector *c{nullptr};
+        size_type i{0};
+    };
+
+    explicit tombstone_sorted_vector(container_type sorted, thread_pool *background = nullptr, double threshold = default_threshold)
+        : data(std::move(sorted)), dead((data.size() + 63) / 64), background(background), threshold(threshold) {}
+    ~tombstone_sorted_vector() { wait(); }
+    // the background worker holds a pointer to data
+    tombstone_sorted_vector(const tombstone_sorted_vector &) = delete;
+    tombstone_sorted_vector &operator=(const tombstone_sorted_vector &) = delete;
+
+    const_iterator begin() const noexcept { return {this, next_alive(0)}; }
+    const_iterator end() const noexcept { return {this, data.size()}; }
+    size_type size() const noexcept { return data.size() - dead_count; }
+    bool empty() const noexcept { return size() == 0; }
+    // slots, dead or alive
+    size_type capacity_used() const noexcept { return data.size(); }
+    size_type dead_slots() const noexcept { return dead_count; }
+
+    // first live element not less than key
+    const_iterator lower_bound(const Key &key) const
+    {
+        return {this, next_alive(data.lower_bound(key) - data.begin())};
+    }
+    const_iterator find(const Key &key) const
+    {
+        const auto found = data.find(key);
+        if (found == data.end() || is_dead(found - data.begin()))
+            return end();
+        return {this, size_type(found - data.begin())};
+    }
+    bool contains(const Key &key) const { return find(key) != end(); }
+
+    // O(log n), no data moves
+    size_type erase(const Key &key)
+    {
+        poll();
+        if (!tombstone(key))
+            return 0;
+        if (compacting)
+            erased_since.push_back(key);
+        else if (dead_count > threshold * data.size())
+            start_compaction();
+        return 1;
+    }
+
+    // reuses a dead slot if there is one for the key, otherwise a real (compacting) insert
+    bool insert(value_type value)
+    {
+        wait();
+        const auto found = data.find(value.k);
+        if (found != data.end())
+        {
+            const size_type pos = found - data.begin();
+            if (!is_dead(pos))
+                return false;
+            found->v = std::move(value.v);
+            dead[pos / 64] &= ~(std::uint64_t(1) << (pos % 64));
+            --dead_count;
+            return true;
+        }
+        compact();
+        data.insert(std::move(value));
+        dead.resize((data.size() + 63) / 64);
+        return true;
+    }
+
+    void batch_insert(std::vector<value_type> selection)
+    {
+        wait();
+        compact();
+        data.batch_insert(std::move(selection));
+        dead.resize((data.size() + 63) / 64);
+    }
+
+    // squeeze the dead slots out now, on this thread
+    void compact()
+    {
+        wait();
+        if (dead_count == 0)
+            return;
+        auto raw = std::move(data).extract();
+        size_type out = 0;
+        for (size_type i = 0; i < raw.size(); ++i)
+            if (!is_dead(i))
+            {
+                if (out != i)
+                    raw[out] = std::move(raw[i]);
+                ++out;
+            }
+        raw.erase(raw.begin() + out, raw.end());
+        data.replace(std::move(raw));
+        reset_bitmap();
+    }
+
+    // swap in a finished background compaction, if there is one
+    void poll()
+    {
+        if (compacting && compacting->done.load(std::memory_order_acquire))
+            finish_compaction();
+    }
+    // block until a running background compaction is finished, and swap it in
+    void wait()
+    {
+        if (!compacting)
+            return;
+        compacting->finished.wait();
+        finish_compaction();
+    }
+
+private:
+    struct compaction
+    {
+        std::atomic<bool> done{false};
+        std::latch finished{1};
+        typename container_type::container_type result;
+    };
+
+    bool is_dead(size_type i) const noexcept { return (dead[i / 64] >> (i % 64)) & 1; }
+
+    // first live slot at or after i, size() of the data if none
+    size_type next_alive(size_type i) const noexcept
+    {
+        const size_type n = data.size();
+        if (i >= n)
+            return n;
+        size_type word = i / 64;
+        std::uint64_t alive = ~dead[word] & (~std::uint64_t(0) << (i % 64));
+        while (alive == 0)
+        {
+            if (++word == dead.size())
+                return n;
+            alive = ~dead[word];
+        }
+        return std::min(n, word * 64 + std::countr_zero(alive));
+    }
+
+    bool tombstone(const Key &key)
+    {
+        const auto found = data.find(key);
+        if (found == data.end())
+            return false;
+        const size_type pos = found - data.begin();
+        if (is_dead(pos))
+            return false;
+        dead[pos / 64] |= std::uint64_t(1) << (pos % 64);
+        ++dead_count;
+        return true;
+    }
+
+    void reset_bitmap()
+    {
+        dead.assign((data.size() + 63) / 64, 0);
+        dead_count = 0;
+    }
+
+    void start_compaction()
+    {
+        if (!background)
+            return compact();
+        compacting = std::make_shared<compaction>();
+        // the worker gets its own copy of the bitmap, the live one keeps changing
+        background->submit([job = compacting, snapshot = dead, source = &data] {
+            auto &result = job->result;
+            result.reserve(source->size());
+            size_type i = 0;
+            for (const auto &elem : *source)
+            {
+                if (!((snapshot[i / 64] >> (i % 64)) & 1))
+                    result.push_back(elem);
+                ++i;
+            }
+            job->done.store(true, std::memory_order_release);
+            job->finished.count_down();
+        });
+    }
+
+    void finish_compaction()
+    {
+        const auto job = std::move(compacting);
+        compacting.reset();
+        data.replace(std::move(job->result));
+        reset_bitmap();
+        for (const Key &key : erased_since)
+            tombstone(key);
+        erased_since.clear();
+    }
+
+    container_type data;
+    std::vector<std::uint64_t> dead;
+    size_type dead_count{0};
+    thread_pool *background;
+    double threshold;
+    std::shared_ptr<compaction> compacting;
+    std::vector<Key> erased_since;
+};
@@ -1,81 +1,135 @@
 #include <benchmark/benchmark.h>
 #include <gtest/gtest.h>
 #include <map>
+#include <set>
 #include <string>
 #include <numeric>
 #include <algorithm>
+#include <cassert>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <memory_resource>
+#include <filesystem>
+#include <optional>
+#include <thread>
+#include <random>
+#include <cmath>
+#include <fcntl.h>
+#include "src/sorted_vector.hpp"
+#include "src/sorted_columns.hpp"
+#include "src/lsm_sorted_vector.hpp"
+#include "src/tombstone_sorted_vector.hpp"
+#include "src/eytzinger_index.hpp"
+#include "src/simd_lower_bound.hpp"
+#include "src/thread_pool.hpp"
+#include "src/radix_sort.hpp"
+#include "src/string_pool.hpp"
+#include "src/indexed_sorted_vector.hpp"
+#include "src/mapped_sorted_vector.hpp"
+#include "src/external_sort_builder.hpp"
+#include "src/concurrent_sorted_vector.hpp"
+#include "src/sharded_sorted_vector.hpp"
+#include "src/interpolation_index.hpp"
+#include "src/learned_index.hpp"
+#include "src/bloom_filter.hpp"
+#include "src/HeavyWeight.h"
+#include "src/packed_memory_array.hpp"
+#include "src/interleaved_lookup.hpp"
+#include "src/huge_page_allocator.hpp"
+#include "src/compressed_columns.hpp"
 using namespace std::string_literals;
 using MyMap = std::map<int, std::string>;
-struct Elem
-{
-    int k;
-    std::string v;
-    friend bool operator<(const Elem &a, const Elem &b) noexcept { return a.k < b.k; }
-    // used for searching for a specific key value
-    friend bool operator<(const Elem &a, int b) noexcept { return a.k < b; }
-    friend bool operator==(const Elem &a, int b) noexcept { return a.k == b; }
-};
+using MyVector = sorted_vector<int, std::string>;
+using Elem = MyVector::value_type;
+using MyColumns = sorted_columns<int, std::string>;
+using MyCompressedColumns = compressed_sorted_columns<int, std::string>;
+using MyLsmVector = lsm_sorted_vector<int, std::string>;
+using MyTombstoneVector = tombstone_sorted_vector<int, std::string>;
+using MyIndexedVector = indexed_sorted_vector<MyVector, eytzinger_index<int>>;
+// values in an arena
+using MyPmrVector = sorted_vector<int, std::pmr::string, std::less<int>, std::pmr::polymorphic_allocator<sorted_entry<int, std::pmr::string>>>;
+// values interned, the vector holds 4 byte handles
+using MyPooledVector = sorted_vector<int, string_pool::handle>;
+using MyMappedVector = mapped_sorted_vector<int>;
+using MyExternalBuilder = external_sort_builder<int>;
+using MyConcurrentVector = concurrent_sorted_vector<int, std::string>;
+using MyShardedVector = sharded_sorted_vector<int, std::string>;
+using MyInterpolationVector = indexed_sorted_vector<MyVector, interpolation_index<int>>;
+using MyLearnedVector = indexed_sorted_vector<MyVector, learned_index<int>>;
+using MyFilteredVector = indexed_sorted_vector<MyVector, bloom_filtered<binary_search_index<int>, int>>;
+using HeavyVector = sorted_vector<int, SomeHeavyWeight>;
+using HeavyElem = HeavyVector::value_type;
+using MyPackedArray = packed_memory_array<int, std::string>;
+using MyHugePageVector = sorted_vector<int, std::string, std::less<int>, huge_page_allocator<Elem>>;
 
-using MyVector = std::vector<Elem>;
+// Every operator new in the process is counted, so the benchmarks can report allocations per operation
+static std::atomic<std::size_t> allocations{0};
 
-// could use lower_bound for speed, but this is used for testing, so avoid checking assumptions with the same assumptions
-bool Contains(const MyVector &vector, int val)
+void *operator new(std::size_t size)
 {
-    const auto found = std::find(vector.begin(), vector.end(), val);
-    return found != vector.end();
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
 }
+[[gnu::noinline]] void *operator new(std::size_t size, std::align_val_t align)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    const std::size_t alignment = static_cast<std::size_t>(align);
+    if (void *p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment))
+        return p;
+    throw std::bad_alloc();
+}
+// noinline, or gcc sees the free() against a new (or the aligned_alloc() above) and warns
+[[gnu::noinline]] void operator delete(void *p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void *p, std::size_t, std::align_val_t) noexcept { std::free(p); }
 
-/*
-BatchDelete: 
- remove a set of elements from a sorted vector as a single op
- relies on fast/stable sort algorithm for performance
-*/
-// Precondition: all elements of selection must exist in vector
-static void BatchDelete(MyVector &vector, std::vector<int> selection)
+// call with the count from before the benchmark loop
+static void ReportAllocations(benchmark::State &state, std::size_t before)
 {
-    std::sort(selection.begin(), selection.end());
-    MyVector::iterator start = vector.begin();
-    MyVector::iterator end = vector.end();
-    for (const int rnd : selection)
-    {
-        const auto found = std::lower_bound(start, end, rnd);
-        start = found + 1;
-        end = end - 1;
-        std::swap(*found, *end);
-    }
-    vector.resize(vector.size() - selection.size());
-    std::sort(vector.begin(), vector.end());
+    state.counters["allocs"] = benchmark::Counter(double(allocations.load() - before), benchmark::Counter::kAvgIterations);
 }
 
-static void BatchInsert(MyVector &vector, std::vector<Elem> selection)
+// could use lower_bound for speed, but this is used for testing, so avoid checking assumptions with the same assumptions
+bool Contains(const MyVector &vector, int val)
 {
-    vector.insert(vector.end(), selection.begin(), selection.end());
-    std::sort(vector.begin(), vector.end());
+    const auto found = std::find_if(vector.begin(), vector.end(), [val](const Elem &e) { return e.k == val; });
+    return found != vector.end();
 }
 
+// The "magic" variants are kept as experiments against the container's own batch functions.
+// They work on the raw storage, and hand it back sorted.
 static void BatchInsertMagic(MyVector &vector, std::vector<Elem> selection)
 {
-    vector.insert(vector.end(), selection.begin(), selection.end());
-    std::make_heap(vector.begin(), vector.end());
-    std::sort(vector.begin(), vector.end());
+    auto raw = std::move(vector).extract();
+    raw.insert(raw.end(), selection.begin(), selection.end());
+    std::make_heap(raw.begin(), raw.end(), vector.value_comp());
+    std::sort(raw.begin(), raw.end(), vector.value_comp());
+    vector.replace(std::move(raw));
 }
 
 // Precondition: all elements of selection must exist in vector
 static void BatchDeleteWithMagic(MyVector &vector, std::vector<int> selection)
 {
+    const auto comp = vector.value_comp();
+    auto raw = std::move(vector).extract();
     std::sort(selection.begin(), selection.end());
-    MyVector::iterator start = vector.begin();
-    MyVector::iterator end = vector.end();
+    MyVector::iterator start = raw.begin();
+    MyVector::iterator end = raw.end();
     for (const int rnd : selection)
     {
-        const auto found = std::lower_bound(start, end, rnd);
+        const auto found = std::lower_bound(start, end, rnd, comp);
         start = found + 1;
         end = end - 1;
         std::swap(*found, *end);
     }
-    vector.resize(vector.size() - selection.size());
-    std::make_heap(vector.begin(), vector.end());
-    std::sort(vector.begin(), vector.end());
+    raw.resize(raw.size() - selection.size());
+    std::make_heap(raw.begin(), raw.end(), comp);
+    std::sort(raw.begin(), raw.end(), comp);
+    vector.replace(std::move(raw));
 }
 
 static MyMap CreateMap(int size)
@@ -91,19 +145,73 @@ static MyMap CreateMap(int size)
     return retval;
 }
 
-static MyVector CreateVector(int size)
+// the keys [0, size) in a pseudo random order, to be fair to the map and the sorts
+static std::vector<int> ShuffledKeys(int size)
 {
-    // to be fair, make the map in a psuedo random order
     std::vector<int> nums;
     nums.resize(size);
     std::iota(nums.begin(), nums.end(), 0);
-    MyVector retval;
-    retval.reserve(size);
     std::random_shuffle(nums.begin(), nums.end());
-    for (auto num : nums)
-        retval.emplace_back(Elem{num, std::to_string(num % 100)});
-    std::sort(retval.begin(), retval.end());
-    return retval;
+    return nums;
+}
+
+// an entry for each shuffled key, with the value make_value(key). elems is the empty container to
+// fill, for the ones that need an allocator passed in
+template<class Container, class MakeValue>
+static Container ShuffledEntries(int size, MakeValue make_value, Container elems = Container())
+{
+    // a bulk build on huge pages takes its page faults up front
+    if constexpr (std::is_same_v<typename Container::allocator_type, huge_page_allocator<Elem>>)
+        reserve_prefaulted(elems, size);
+    else
+        elems.reserve(size);
+    for (const int num : ShuffledKeys(size))
+        elems.push_back({num, make_value(num)});
+    return elems;
+}
+
+template<class Container = MyVector::container_type>
+static Container ShuffledElems(int size)
+{
+    return ShuffledEntries<Container>(size, [](int num) { return std::to_string(num % 100); });
+}
+
+static MyVector CreateVector(int size)
+{
+    return MyVector{ShuffledElems(size)};
+}
+
+static MyVector CreateVector(int size, thread_pool &pool)
+{
+    return MyVector{ShuffledElems(size), pool};
+}
+
+static MyHugePageVector CreateHugePageVector(int size)
+{
+    return MyHugePageVector{ShuffledElems<MyHugePageVector::container_type>(size)};
+}
+
+static MyPmrVector CreatePmrVector(int size, std::pmr::memory_resource *arena)
+{
+    return MyPmrVector{ShuffledEntries(size, [arena](int num) { return std::pmr::string(std::to_string(num % 100), arena); },
+                                       MyPmrVector::container_type(arena))};
+}
+
+static MyPooledVector CreatePooledVector(int size, string_pool &pool)
+{
+    return MyPooledVector{ShuffledEntries<MyPooledVector::container_type>(size, [&pool](int num) { return pool.intern(std::to_string(num % 100)); })};
+}
+
+// same contents as CreateVector, with the keys compressed
+static MyCompressedColumns CreateCompressedColumns(int size)
+{
+    return MyCompressedColumns{ShuffledElems(size)};
+}
+
+// same contents as CreateVector, in key/value columns
+static MyColumns CreateColumns(int size)
+{
+    return MyColumns{ShuffledElems(size)};
 }
 
 static std::vector<int> RandomSelection(int size, int select_size)
@@ -116,8 +224,73 @@ static std::vector<int> RandomSelection(int size, int select_size)
     return std::vector<int>{nums.begin(), nums.begin() + select_size};
 }
 
+// key layouts for the lookup accelerators, which care about how evenly the keys are spread
+enum class Keys
+{
+    uniform,   // evenly spaced, with a little jitter
+    clustered, // runs of consecutive keys, far apart
+    zipf       // heavy tailed gaps, mostly small with the odd huge one
+};
+
+// size distinct keys, sorted
+static std::vector<int> DistributedKeys(int size, Keys layout)
+{
+    std::mt19937 rng(42);
+    std::vector<int> keys;
+    keys.reserve(size);
+    int key = 0;
+    for (int i = 0; i < size; ++i)
+    {
+        switch (layout)
+        {
+        case Keys::uniform:
+            key = i * 8 + int(rng() % 8);
+            break;
+        case Keys::clustered:
+            key += (i % 4096 == 0) ? 1 + int(rng() % 65536) : 1;
+            break;
+        case Keys::zipf:
+        {
+            const double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+            key += 1 + int(std::min(4096.0, std::pow(1.0 - u, -1.0 / 1.1)));
+            break;
+        }
+        }
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+static MyVector CreateDistributedVector(const std::vector<int> &keys)
+{
+    MyVector::container_type elems;
+    elems.reserve(keys.size());
+    for (const int key : keys)
+        elems.push_back(Elem{key, std::to_string(key % 100)});
+    return MyVector{sorted_unique, std::move(elems)};
+}
+
+static std::vector<int> RandomKeys(const std::vector<int> &keys, int select_size)
+{
+    std::vector<int> retval;
+    for (const int i : RandomSelection(keys.size(), select_size))
+        retval.push_back(keys[i]);
+    return retval;
+}
+
+// ~1KB payloads, each one tagged with its key so the tests can check it travelled with it
+static HeavyVector::container_type ShuffledHeavyElems(int size)
+{
+    return ShuffledEntries<HeavyVector::container_type>(size, [](int num) {
+        SomeHeavyWeight retval{};
+        retval.integers[0] = num;
+        return retval;
+    });
+}
+
 static void MapCreation(benchmark::State &state)
 {
+    const std::size_t before = allocations;
     for (auto _ : state)
     {
         benchmark::DoNotOptimize(CreateMap(state.range(0)));
@@ -125,10 +298,12 @@ static void MapCreation(benchmark::State &state)
         benchmark::ClobberMemory();
         state.ResumeTiming();
     }
+    ReportAllocations(state, before);
 }
 
 static void VectorCreation(benchmark::State &state)
 {
+    const std::size_t before = allocations;
     for (auto _ : state)
     {
         benchmark::DoNotOptimize(CreateVector(state.range(0)));
@@ -137,324 +312,2221 @@ static void VectorCreation(benchmark::State &state)
         state.ResumeTiming();
     }
     benchmark::ClobberMemory();
+    ReportAllocations(state, before);
 }
 
-static void MapLookup(benchmark::State &state)
+// as VectorCreation, with the entries on 2MB pages
+static void VectorCreationHugePages(benchmark::State &state)
 {
+    const std::size_t before = allocations;
     for (auto _ : state)
     {
+        benchmark::DoNotOptimize(CreateHugePageVector(state.range(0)));
         state.PauseTiming();
-        const auto map = CreateMap(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), 100);
+        benchmark::ClobberMemory();
         state.ResumeTiming();
-        for (const int rnd : random_Selection)
-            benchmark::DoNotOptimize(map.lower_bound(rnd));
     }
+    benchmark::ClobberMemory();
+    ReportAllocations(state, before);
 }
 
-static void VectorLookup(benchmark::State &state)
+// everything, the vector and the strings, comes from one bump arena that is dropped in one go
+static void VectorCreationArena(benchmark::State &state)
 {
+    const std::size_t before = allocations;
     for (auto _ : state)
     {
+        std::pmr::monotonic_buffer_resource arena;
+        benchmark::DoNotOptimize(CreatePmrVector(state.range(0), &arena));
         state.PauseTiming();
-        const auto vector = CreateVector(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), 100);
+        benchmark::ClobberMemory();
         state.ResumeTiming();
-        for (const int rnd : random_Selection)
-            benchmark::DoNotOptimize(std::lower_bound(vector.begin(), vector.end(), rnd));
     }
+    benchmark::ClobberMemory();
+    ReportAllocations(state, before);
 }
 
-static void MapDelete(benchmark::State &state)
+static void VectorCreationPooled(benchmark::State &state)
 {
+    const std::size_t before = allocations;
     for (auto _ : state)
     {
+        string_pool pool;
+        benchmark::DoNotOptimize(CreatePooledVector(state.range(0), pool));
         state.PauseTiming();
-        auto map = CreateMap(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), 100);
+        benchmark::ClobberMemory();
         state.ResumeTiming();
-        for (const int rnd : random_Selection)
-        {
-            const MyMap::iterator pos = map.lower_bound(rnd);
-            map.erase(pos);
-        }
     }
+    benchmark::ClobberMemory();
+    ReportAllocations(state, before);
 }
 
-static void VectorDelete(benchmark::State &state)
+// the alternative to VectorCreation, a table saved earlier: open the file and do the first lookup.
+// The file's pages are dropped from the page cache before each open, so it is a cold start
+// (as cold as the kernel allows without root, the disk cache may still have it)
+static void VectorOpenMapped(benchmark::State &state)
 {
+    const auto path = (std::filesystem::temp_directory_path() / ("sorted_vector_" + std::to_string(state.range(0)) + ".bin")).string();
+    save(CreateVector(state.range(0)), path);
+    const auto random_Selection = RandomSelection(state.range(0), 100);
+    std::size_t next = 0;
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), 100);
-        state.ResumeTiming();
-        for (const int rnd : random_Selection)
+        if (const int fd = ::open(path.c_str(), O_RDONLY); fd >= 0)
         {
-            vector.erase(std::lower_bound(vector.begin(), vector.end(), rnd));
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
         }
+        state.ResumeTiming();
+        const MyMappedVector vector{path};
+        benchmark::DoNotOptimize(vector.value(vector.find(random_Selection[next++ % random_Selection.size()])));
     }
+    std::filesystem::remove(path);
 }
 
-static void MapDeleteHalf(benchmark::State &state)
+// same records as VectorCreation, built through sorted runs on disk with only 4MB to play with
+static constexpr std::size_t SmallBudget = 4 * 1024 * 1024;
+
+static void VectorCreationExternal(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto map = CreateMap(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), state.range(0) / 2);
+        auto elems = ShuffledElems(state.range(0));
+        state.ResumeTiming();
+        MyExternalBuilder builder(SmallBudget);
+        for (auto &elem : elems)
+            builder.add(std::move(elem));
+        benchmark::DoNotOptimize(builder.finish());
+        state.PauseTiming();
+        benchmark::ClobberMemory();
         state.ResumeTiming();
-        for (const int rnd : random_Selection)
-        {
-            const MyMap::iterator pos = map.lower_bound(rnd);
-            map.erase(pos);
-        }
     }
 }
 
-static void VectorMultiDelete(benchmark::State &state)
+static void VectorCreationExternalToFile(benchmark::State &state)
 {
+    const auto path = (std::filesystem::temp_directory_path() / ("sorted_vector_ext_" + std::to_string(state.range(0)) + ".bin")).string();
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
-        const auto random_selection = RandomSelection(state.range(0), 100);
+        auto elems = ShuffledElems(state.range(0));
         state.ResumeTiming();
-        BatchDelete(vector, random_selection);
+        MyExternalBuilder builder(SmallBudget);
+        for (auto &elem : elems)
+            builder.add(std::move(elem));
+        builder.finish(path);
     }
+    std::filesystem::remove(path);
 }
 
-static void VectorMultiDeleteHalf(benchmark::State &state)
+// thread count sweep, range(1) is the number of threads sorting
+static void VectorCreationParallel(benchmark::State &state)
 {
+    thread_pool pool(state.range(1));
     for (auto _ : state)
     {
+        benchmark::DoNotOptimize(CreateVector(state.range(0), pool));
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
-        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        benchmark::ClobberMemory();
         state.ResumeTiming();
-        BatchDelete(vector, random_selection);
     }
+    benchmark::ClobberMemory();
 }
 
-static void VectorMultiDeleteMagic(benchmark::State &state)
+// the ordering step on its own, comparison sort vs radix sort
+static void VectorSortStd(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
-        const auto random_selection = RandomSelection(state.range(0), 100);
+        auto elems = ShuffledElems(state.range(0));
         state.ResumeTiming();
-        BatchDeleteWithMagic(vector, random_selection);
+        std::sort(elems.begin(), elems.end(), [](const Elem &a, const Elem &b) { return a.k < b.k; });
     }
 }
 
-static void MapInsert(benchmark::State &state)
+static void VectorSortRadix(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto map = CreateMap(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), 100);
-        for (const int rnd : random_Selection)
-        {
-            const MyMap::iterator pos = map.lower_bound(rnd);
-            map.erase(pos);
-        }
+        auto elems = ShuffledElems(state.range(0));
         state.ResumeTiming();
-        for (const int rnd : random_Selection)
-            map.insert(std::make_pair(rnd, ""s));
+        radix_sort(elems, [](const Elem &e) { return e.k; });
     }
 }
 
-
-static void VectorBatchInsert(benchmark::State &state)
+// the heavy payload benchmarks stop at 1M, that is already 1GB
+static void HeavySortStd(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
-        const auto random_selection = RandomSelection(state.range(0), 100);
-        BatchDelete(vector, random_selection);
-        std::vector<Elem> new_elems{random_selection.size()};
-        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
-                       { return Elem{r, std::to_string(r)}; });
+        auto elems = ShuffledHeavyElems(state.range(0));
         state.ResumeTiming();
-
-        BatchInsert(vector, new_elems);
+        std::sort(elems.begin(), elems.end(), [](const HeavyElem &a, const HeavyElem &b) { return a.k < b.k; });
     }
 }
 
-static void MapInsertHalf(benchmark::State &state)
+static void HeavySortIndirect(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto map = CreateMap(state.range(0));
-        const auto random_Selection = RandomSelection(state.range(0), state.range(0) / 2);
-        for (const int rnd : random_Selection)
-        {
-            const MyMap::iterator pos = map.lower_bound(rnd);
-            map.erase(pos);
-        }
+        auto elems = ShuffledHeavyElems(state.range(0));
         state.ResumeTiming();
-        for (const int rnd : random_Selection)
-            map.insert(std::make_pair(rnd, ""s));
+        sorted_detail::sort_entries(elems, std::less<int>());
     }
 }
 
-static void VectorBatchInsertHalf(benchmark::State &state)
+static void HeavyBatchInsertHalf(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
+        HeavyVector vector{ShuffledHeavyElems(state.range(0))};
         const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
-        BatchDelete(vector, random_selection);
-        std::vector<Elem> new_elems{random_selection.size()};
-        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
-                       { return Elem{r, std::to_string(r)}; });
+        vector.batch_erase(random_selection);
+        std::vector<HeavyElem> new_elems(random_selection.size());
+        for (std::size_t i = 0; i < random_selection.size(); ++i)
+            new_elems[i].k = random_selection[i];
         state.ResumeTiming();
 
-        BatchInsert(vector, new_elems);
+        vector.batch_insert(std::move(new_elems));
     }
 }
 
-static void VectorBatchInsertHalfMagic(benchmark::State &state)
+static void MapLookup(benchmark::State &state)
 {
     for (auto _ : state)
     {
         state.PauseTiming();
-        auto vector = CreateVector(state.range(0));
-        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
-        BatchDelete(vector, random_selection);
-        std::vector<Elem> new_elems{random_selection.size()};
-        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
-                       { return Elem{r, std::to_string(r)}; });
+        const auto map = CreateMap(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
         state.ResumeTiming();
-
-        BatchInsertMagic(vector, new_elems);
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(map.lower_bound(rnd));
     }
 }
 
-constexpr int MAX = 16;
-BENCHMARK(MapCreation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorCreation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-
-BENCHMARK(MapLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-
-BENCHMARK(MapDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorMultiDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-
-BENCHMARK(MapDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorMultiDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorMultiDeleteMagic)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-
-BENCHMARK(MapInsert)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorBatchInsert)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-
-BENCHMARK(MapInsertHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorBatchInsertHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-BENCHMARK(VectorBatchInsertHalfMagic)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
-//BENCHMARK(VectorDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024); this is just masocistic
-
-// Module tests section.
-// It doesn't matter how fast it is, if it doesnt work
-
-TEST(SortedVector, Create)
+static void VectorLookup(benchmark::State &state)
 {
-    // check head tail and midpoint
-    auto vector = CreateVector(100);
-    EXPECT_EQ(vector.size(), 100);
-    EXPECT_EQ(vector[0].v, "0"s);
-    EXPECT_EQ(vector[50].v, "50"s);
-    EXPECT_EQ(vector[99].v, "99"s);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(vector.lower_bound(rnd));
+    }
 }
 
-TEST(SortedVector, Lookup)
+// as VectorLookup, with the entries on 2MB pages
+static void VectorLookupHugePages(benchmark::State &state)
 {
-    const auto vector = CreateVector(100);
-    const auto random_Selection = RandomSelection(vector.size(), 10);
-    for (const int rnd : random_Selection)
+    for (auto _ : state)
     {
-        const auto found = std::lower_bound(vector.begin(), vector.end(), rnd);
-        EXPECT_EQ(found->v, std::to_string(rnd));
+        state.PauseTiming();
+        const auto vector = CreateHugePageVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(vector.lower_bound(rnd));
     }
 }
 
-TEST(SortedVector, Delete)
+static void VectorLookupEytzinger(benchmark::State &state)
 {
-    auto vector = CreateVector(100);
-    const auto random_Selection = RandomSelection(vector.size(), 10);
-    for (const int rnd : random_Selection)
+    for (auto _ : state)
     {
-        const auto found = std::lower_bound(vector.begin(), vector.end(), rnd);
-        vector.erase(found);
+        state.PauseTiming();
+        const MyIndexedVector vector{CreateVector(state.range(0))};
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(vector.lower_bound(rnd));
     }
-    // check deleted items removed
-    for (const int rnd : random_Selection)
-        EXPECT_FALSE(Contains(vector, rnd));
-    // check size changed
-    EXPECT_EQ(vector.size(), 90);
 }
 
-TEST(SortedVector, MultiDelete)
+// lower_bound kernel family, all over the same vector
+// VectorLookupStd is the generic branchy std::lower_bound, for comparison
+static void VectorLookupStd(benchmark::State &state)
 {
-    auto vector = CreateVector(100);
-    const auto random_selection = RandomSelection(vector.size(), 10);
-    BatchDelete(vector, random_selection);
-    // check deleted items removed
-    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end()));
-    for (const int rnd : random_selection)
-        EXPECT_FALSE(Contains(vector, rnd));
-    // check size changed
-    EXPECT_EQ(vector.size(), 90);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(std::lower_bound(vector.begin(), vector.end(), rnd, vector.value_comp()));
+    }
 }
 
-TEST(SortedVector, MagicDelete)
+template<simd_search::level Level>
+static void VectorLookupKernel(benchmark::State &state)
 {
-    auto vector = CreateVector(100);
-    const auto random_selection = RandomSelection(vector.size(), 10);
-    BatchDeleteWithMagic(vector, random_selection);
-    // check deleted items removed
-    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end()));
-    for (const int rnd : random_selection)
+    if (static_cast<int>(Level) > static_cast<int>(simd_search::best_level()))
+    {
+        state.SkipWithError("instruction set not supported on this cpu");
+        return;
+    }
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(simd_search::lower_bound(Level, &vector.begin()->k, vector.size(), sizeof(Elem), rnd));
+    }
+}
+
+static void VectorLookupScalar(benchmark::State &state) { return VectorLookupKernel<simd_search::level::scalar>(state); }
+static void VectorLookupSSE(benchmark::State &state) { return VectorLookupKernel<simd_search::level::sse>(state); }
+static void VectorLookupAVX2(benchmark::State &state) { return VectorLookupKernel<simd_search::level::avx2>(state); }
+
+// a stream of 1000 random finds, with range(1) searches interleaved. 1 is one search at a time
+static void VectorLookupInterleaved(benchmark::State &state)
+{
+    std::vector<std::size_t> positions(1000);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 1000);
+        state.ResumeTiming();
+        interleaved::find(vector, std::span<const int>(random_Selection), std::span<std::size_t>(positions), state.range(1));
+        benchmark::DoNotOptimize(positions.data());
+    }
+}
+
+// VectorLookup over the key layouts, Table is MyVector (plain binary search) or an indexed vector
+template<class Table, Keys layout>
+static void VectorLookupDistribution(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto keys = DistributedKeys(state.range(0), layout);
+        const Table vector{CreateDistributedVector(keys)};
+        const auto random_Selection = RandomKeys(keys, 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(vector.lower_bound(rnd));
+    }
+}
+static void VectorLookupUniformBinary(benchmark::State &state) { return VectorLookupDistribution<MyVector, Keys::uniform>(state); }
+static void VectorLookupUniformInterpolation(benchmark::State &state) { return VectorLookupDistribution<MyInterpolationVector, Keys::uniform>(state); }
+static void VectorLookupUniformLearned(benchmark::State &state) { return VectorLookupDistribution<MyLearnedVector, Keys::uniform>(state); }
+static void VectorLookupClusteredBinary(benchmark::State &state) { return VectorLookupDistribution<MyVector, Keys::clustered>(state); }
+static void VectorLookupClusteredInterpolation(benchmark::State &state) { return VectorLookupDistribution<MyInterpolationVector, Keys::clustered>(state); }
+static void VectorLookupClusteredLearned(benchmark::State &state) { return VectorLookupDistribution<MyLearnedVector, Keys::clustered>(state); }
+static void VectorLookupZipfBinary(benchmark::State &state) { return VectorLookupDistribution<MyVector, Keys::zipf>(state); }
+static void VectorLookupZipfInterpolation(benchmark::State &state) { return VectorLookupDistribution<MyInterpolationVector, Keys::zipf>(state); }
+static void VectorLookupZipfLearned(benchmark::State &state) { return VectorLookupDistribution<MyLearnedVector, Keys::zipf>(state); }
+
+// find() with range(1) percent of the keys present, the rest are misses (keys past the end)
+static std::vector<int> HitRatioSelection(int size, int hit_percent)
+{
+    auto retval = RandomSelection(size, 100);
+    for (int i = hit_percent; i < 100; ++i)
+        retval[i] += size;
+    return retval;
+}
+
+template<class Table>
+static void VectorFindHitRatio(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const Table vector{CreateVector(state.range(0))};
+        const auto random_Selection = HitRatioSelection(state.range(0), state.range(1));
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(vector.find(rnd));
+    }
+}
+static void VectorFindUnfiltered(benchmark::State &state) { return VectorFindHitRatio<MyVector>(state); }
+static void VectorFindFiltered(benchmark::State &state) { return VectorFindHitRatio<MyFilteredVector>(state); }
+
+static void ColumnsLookup(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto columns = CreateColumns(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(columns.lower_bound(rnd));
+    }
+}
+
+static void CompressedColumnsLookup(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto columns = CreateCompressedColumns(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.counters["key_bytes"] = double(columns.key_bytes()) / double(columns.size());
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(columns.find(rnd));
+    }
+}
+
+static void VectorLookupMany(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(vector.find_many(random_Selection));
+    }
+}
+
+static void ColumnsLookupMany(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        const auto columns = CreateColumns(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(columns.find_many(random_Selection));
+    }
+}
+
+// VectorLookup from several reader threads, while a writer thread keeps erasing and re-inserting
+// batches of 1000. Thread 0 sets up the table and runs the writer, the readers never block on it
+static std::unique_ptr<MyConcurrentVector> concurrent_table;
+static std::atomic<int> concurrent_readers{0};
+
+static void ConcurrentLookup(benchmark::State &state)
+{
+    std::atomic<bool> stop{false};
+    std::thread writer;
+    if (state.thread_index() == 0)
+    {
+        concurrent_table = std::make_unique<MyConcurrentVector>(CreateVector(state.range(0)));
+        writer = std::thread([&stop, size = state.range(0)] {
+            const auto keys = RandomSelection(size, 1000);
+            std::vector<Elem> elems;
+            for (const int key : keys)
+                elems.push_back(Elem{key, std::to_string(key % 100)});
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                concurrent_table->batch_erase(keys);
+                concurrent_table->batch_insert(elems);
+            }
+        });
+    }
+    const auto random_Selection = RandomSelection(state.range(0), 100);
+    ++concurrent_readers;
+    {
+        // the timing loop starts together on every thread, so the table exists by then
+        std::optional<MyConcurrentVector::reader> reader;
+        for (auto _ : state)
+        {
+            if (!reader)
+                reader.emplace(*concurrent_table);
+            const auto snapshot = reader->read();
+            for (const int rnd : random_Selection)
+                benchmark::DoNotOptimize(snapshot.find(rnd));
+        }
+    }
+    --concurrent_readers;
+    if (state.thread_index() == 0)
+    {
+        stop = true;
+        writer.join();
+        while (concurrent_readers != 0)
+            std::this_thread::yield();
+        concurrent_table.reset();
+    }
+}
+
+static void MapDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto map = CreateMap(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+        {
+            const MyMap::iterator pos = map.lower_bound(rnd);
+            map.erase(pos);
+        }
+    }
+}
+
+static void VectorDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+        {
+            vector.erase(vector.lower_bound(rnd));
+        }
+    }
+}
+
+static void ColumnsDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto columns = CreateColumns(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+        {
+            columns.erase(columns.lower_bound(rnd));
+        }
+    }
+}
+
+static void ColumnsMultiDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto columns = CreateColumns(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        columns.batch_erase(random_selection);
+    }
+}
+
+static void CompressedColumnsMultiDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto columns = CreateCompressedColumns(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        columns.batch_erase(random_selection);
+    }
+}
+
+static void TombstoneDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        MyTombstoneVector vector{CreateVector(state.range(0))};
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            vector.erase(rnd);
+    }
+}
+
+static void MapDeleteHalf(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto map = CreateMap(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), state.range(0) / 2);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+        {
+            const MyMap::iterator pos = map.lower_bound(rnd);
+            map.erase(pos);
+        }
+    }
+}
+
+// random single key churn: 100 random keys erased, then put back, one at a time
+static void MapChurn(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto map = CreateMap(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            map.erase(rnd);
+        for (const int rnd : random_Selection)
+            map.emplace(rnd, std::to_string(rnd % 100));
+    }
+}
+
+static void VectorChurn(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            vector.erase(rnd);
+        for (const int rnd : random_Selection)
+            vector.insert(Elem{rnd, std::to_string(rnd % 100)});
+    }
+}
+
+static void PackedChurn(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        MyPackedArray array{CreateVector(state.range(0))};
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            array.erase(rnd);
+        for (const int rnd : random_Selection)
+            array.insert(Elem{rnd, std::to_string(rnd % 100)});
+    }
+}
+
+// drop the middle half, [size / 4, 3 * size / 4), as a key range
+static void MapDeleteRange(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto map = CreateMap(state.range(0));
+        state.ResumeTiming();
+        map.erase(map.lower_bound(state.range(0) / 4), map.lower_bound(3 * state.range(0) / 4));
+    }
+}
+
+static void VectorDeleteRange(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        state.ResumeTiming();
+        vector.erase_range(state.range(0) / 4, 3 * state.range(0) / 4);
+    }
+}
+
+// the same keys, as a batch of point deletes
+static void VectorMultiDeleteRange(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        std::vector<int> keys(state.range(0) / 2);
+        std::iota(keys.begin(), keys.end(), state.range(0) / 4);
+        state.ResumeTiming();
+        vector.batch_erase(std::move(keys));
+    }
+}
+
+// put the middle half back, as one pre-sorted block
+static void VectorSpliceRange(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        vector.erase_range(state.range(0) / 4, 3 * state.range(0) / 4);
+        std::vector<Elem> block;
+        block.reserve(state.range(0) / 2);
+        for (int key = state.range(0) / 4; key < 3 * state.range(0) / 4; ++key)
+            block.push_back(Elem{key, std::to_string(key % 100)});
+        state.ResumeTiming();
+        vector.insert_range(sorted_unique, std::move(block));
+    }
+}
+
+// visit 1000 keys from a random start
+static void MapRangeScan(benchmark::State &state)
+{
+    const auto map = CreateMap(state.range(0));
+    const auto random_Selection = RandomSelection(state.range(0), 100);
+    for (auto _ : state)
+        for (const int rnd : random_Selection)
+        {
+            std::size_t total = 0;
+            for (auto it = map.lower_bound(rnd), last = map.lower_bound(rnd + 1000); it != last; ++it)
+                total += it->second.size();
+            benchmark::DoNotOptimize(total);
+        }
+}
+
+static void VectorRangeScan(benchmark::State &state)
+{
+    const auto vector = CreateVector(state.range(0));
+    const auto random_Selection = RandomSelection(state.range(0), 100);
+    for (auto _ : state)
+        for (const int rnd : random_Selection)
+        {
+            std::size_t total = 0;
+            for (const auto &elem : vector.range(rnd, rnd + 1000))
+                total += elem.v.size();
+            benchmark::DoNotOptimize(total);
+        }
+}
+
+// single deletes, compacting inline each time a quarter of the slots are dead
+static void TombstoneDeleteHalf(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        MyTombstoneVector vector{CreateVector(state.range(0))};
+        const auto random_Selection = RandomSelection(state.range(0), state.range(0) / 2);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            vector.erase(rnd);
+    }
+}
+
+// as above, with the compaction on a background worker
+static void TombstoneDeleteHalfBackground(benchmark::State &state)
+{
+    thread_pool pool(2);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        MyTombstoneVector vector{CreateVector(state.range(0)), &pool};
+        const auto random_Selection = RandomSelection(state.range(0), state.range(0) / 2);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            vector.erase(rnd);
+        state.PauseTiming();
+        vector.wait();
+        state.ResumeTiming();
+    }
+}
+
+static void VectorMultiDelete(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        vector.batch_erase(random_selection);
+    }
+}
+
+static void VectorMultiDeleteHalf(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        state.ResumeTiming();
+        vector.batch_erase(random_selection);
+    }
+}
+
+// range(1) is the number of threads, the table is split in 4 shards per thread
+static void ShardedMultiDeleteHalf(benchmark::State &state)
+{
+    thread_pool pool(state.range(1));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        MyShardedVector vector{CreateVector(state.range(0)), pool};
+        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        state.ResumeTiming();
+        vector.batch_erase(random_selection);
+    }
+}
+
+static void VectorMultiDeleteMagic(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        BatchDeleteWithMagic(vector, random_selection);
+    }
+}
+
+static void MapInsert(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto map = CreateMap(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        for (const int rnd : random_Selection)
+        {
+            const MyMap::iterator pos = map.lower_bound(rnd);
+            map.erase(pos);
+        }
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            map.insert(std::make_pair(rnd, ""s));
+    }
+}
+
+
+static void VectorBatchInsert(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), 100);
+        vector.batch_erase(random_selection);
+        std::vector<Elem> new_elems{random_selection.size()};
+        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                       { return Elem{r, std::to_string(r)}; });
+        state.ResumeTiming();
+
+        vector.batch_insert(new_elems);
+    }
+}
+
+// single inserts, one at a time, into the log-structured version
+static void LsmInsert(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), 100);
+        vector.batch_erase(random_selection);
+        MyLsmVector lsm{std::move(vector)};
+        state.ResumeTiming();
+        for (const int rnd : random_selection)
+            lsm.insert(Elem{rnd, ""s});
+    }
+}
+
+// steady state: take 100 keys out and put them back, over and over. allocs should be 0 with scratch
+static void VectorBatchCycle(benchmark::State &state)
+{
+    auto vector = CreateVector(state.range(0));
+    const auto random_selection = RandomSelection(state.range(0), 100);
+    std::vector<Elem> new_elems{random_selection.size()};
+    std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                   { return Elem{r, std::to_string(r % 100)}; });
+    MyVector::scratch work;
+    // one cycle to grow the scratch buffers
+    vector.batch_erase(random_selection, work);
+    vector.batch_insert(new_elems, work);
+    const std::size_t before = allocations;
+    for (auto _ : state)
+    {
+        vector.batch_erase(random_selection, work);
+        vector.batch_insert(new_elems, work);
+    }
+    ReportAllocations(state, before);
+}
+
+// same cycle, with the batches passed by value
+static void VectorBatchCycleByValue(benchmark::State &state)
+{
+    auto vector = CreateVector(state.range(0));
+    const auto random_selection = RandomSelection(state.range(0), 100);
+    std::vector<Elem> new_elems{random_selection.size()};
+    std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                   { return Elem{r, std::to_string(r % 100)}; });
+    const std::size_t before = allocations;
+    for (auto _ : state)
+    {
+        vector.batch_erase(random_selection);
+        vector.batch_insert(new_elems);
+    }
+    ReportAllocations(state, before);
+}
+
+static void MapInsertHalf(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto map = CreateMap(state.range(0));
+        const auto random_Selection = RandomSelection(state.range(0), state.range(0) / 2);
+        for (const int rnd : random_Selection)
+        {
+            const MyMap::iterator pos = map.lower_bound(rnd);
+            map.erase(pos);
+        }
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            map.insert(std::make_pair(rnd, ""s));
+    }
+}
+
+static void LsmInsertHalf(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        vector.batch_erase(random_selection);
+        MyLsmVector lsm{std::move(vector)};
+        state.ResumeTiming();
+        for (const int rnd : random_selection)
+            lsm.insert(Elem{rnd, ""s});
+    }
+}
+
+static void LsmLookup(benchmark::State &state)
+{
+    // half the elements arrived one at a time, so there are plenty of runs to check
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto inserted = RandomSelection(state.range(0), state.range(0) / 2);
+        vector.batch_erase(inserted);
+        MyLsmVector lsm{std::move(vector)};
+        for (const int rnd : inserted)
+            lsm.insert(Elem{rnd, ""s});
+        const auto random_Selection = RandomSelection(state.range(0), 100);
+        state.ResumeTiming();
+        for (const int rnd : random_Selection)
+            benchmark::DoNotOptimize(lsm.find(rnd));
+    }
+}
+
+static void VectorBatchInsertHalf(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        vector.batch_erase(random_selection);
+        std::vector<Elem> new_elems{random_selection.size()};
+        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                       { return Elem{r, std::to_string(r)}; });
+        state.ResumeTiming();
+
+        vector.batch_insert(new_elems);
+    }
+}
+
+static void ShardedBatchInsertHalf(benchmark::State &state)
+{
+    thread_pool pool(state.range(1));
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        MyShardedVector vector{CreateVector(state.range(0)), pool};
+        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        vector.batch_erase(random_selection);
+        std::vector<Elem> new_elems{random_selection.size()};
+        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                       { return Elem{r, std::to_string(r)}; });
+        state.ResumeTiming();
+
+        vector.batch_insert(new_elems);
+    }
+}
+
+static void VectorBatchInsertHalfMagic(benchmark::State &state)
+{
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        auto vector = CreateVector(state.range(0));
+        const auto random_selection = RandomSelection(state.range(0), state.range(0) / 2);
+        vector.batch_erase(random_selection);
+        std::vector<Elem> new_elems{random_selection.size()};
+        std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                       { return Elem{r, std::to_string(r)}; });
+        state.ResumeTiming();
+
+        BatchInsertMagic(vector, new_elems);
+    }
+}
+
+constexpr int MAX = 16;
+BENCHMARK(MapCreation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorCreation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorCreationHugePages)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorOpenMapped)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorCreationExternal)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorCreationExternalToFile)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorCreationArena)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorCreationPooled)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorSortStd)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorSortRadix)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(HeavySortStd)->RangeMultiplier(4)->Range(1024 * 16, 1024 * 1024);
+BENCHMARK(HeavySortIndirect)->RangeMultiplier(4)->Range(1024 * 16, 1024 * 1024);
+BENCHMARK(HeavyBatchInsertHalf)->RangeMultiplier(4)->Range(1024 * 16, 1024 * 1024);
+BENCHMARK(VectorCreationParallel)->ArgsProduct({benchmark::CreateRange(1024 * 256, MAX * 1024 * 1024, 4), {1, 2, 4, 8}})->UseRealTime();
+
+BENCHMARK(MapLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupHugePages)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupEytzinger)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupStd)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupScalar)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupSSE)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupAVX2)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupInterleaved)->ArgsProduct({benchmark::CreateRange(1024 * 256, MAX * 1024 * 1024, 4), {1, 2, 4, 8, 16, 32, 64}});
+BENCHMARK(VectorLookupUniformBinary)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupUniformInterpolation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupUniformLearned)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupClusteredBinary)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupClusteredInterpolation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupClusteredLearned)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupZipfBinary)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupZipfInterpolation)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupZipfLearned)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorFindUnfiltered)->ArgsProduct({benchmark::CreateRange(1024 * 256, MAX * 1024 * 1024, 4), {0, 10, 50, 90, 100}});
+BENCHMARK(VectorFindFiltered)->ArgsProduct({benchmark::CreateRange(1024 * 256, MAX * 1024 * 1024, 4), {0, 10, 50, 90, 100}});
+BENCHMARK(ColumnsLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(CompressedColumnsLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorLookupMany)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(ColumnsLookupMany)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(ConcurrentLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024)->Threads(1)->Threads(2)->Threads(4)->UseRealTime();
+
+BENCHMARK(MapDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(MapChurn)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorChurn)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(PackedChurn)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(TombstoneDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorMultiDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(ColumnsDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(ColumnsMultiDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(CompressedColumnsMultiDelete)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+
+BENCHMARK(MapDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(MapDeleteRange)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorDeleteRange)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorMultiDeleteRange)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorSpliceRange)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(MapRangeScan)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorRangeScan)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(TombstoneDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(TombstoneDeleteHalfBackground)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorMultiDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(ShardedMultiDeleteHalf)->ArgsProduct({benchmark::CreateRange(1024 * 256, MAX * 1024 * 1024, 4), {1, 2, 4, 8}})->UseRealTime();
+BENCHMARK(VectorMultiDeleteMagic)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+
+BENCHMARK(MapInsert)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorBatchInsert)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(LsmInsert)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorBatchCycle)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorBatchCycleByValue)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+
+BENCHMARK(MapInsertHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(VectorBatchInsertHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(ShardedBatchInsertHalf)->ArgsProduct({benchmark::CreateRange(1024 * 256, MAX * 1024 * 1024, 4), {1, 2, 4, 8}})->UseRealTime();
+BENCHMARK(VectorBatchInsertHalfMagic)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(LsmInsertHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+BENCHMARK(LsmLookup)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024);
+//BENCHMARK(VectorDeleteHalf)->RangeMultiplier(4)->Range(1024 * 256, MAX * 1024 * 1024); this is just masocistic
+
+// Module tests section.
+// It doesn't matter how fast it is, if it doesnt work
+
+TEST(SortedVector, Create)
+{
+    // check head tail and midpoint
+    auto vector = CreateVector(100);
+    EXPECT_EQ(vector.size(), 100);
+    EXPECT_EQ(vector.nth(0)->v, "0"s);
+    EXPECT_EQ(vector.nth(50)->v, "50"s);
+    EXPECT_EQ(vector.nth(99)->v, "99"s);
+}
+
+TEST(SortedVector, Lookup)
+{
+    const auto vector = CreateVector(100);
+    const auto random_Selection = RandomSelection(vector.size(), 10);
+    for (const int rnd : random_Selection)
+    {
+        const auto found = vector.lower_bound(rnd);
+        EXPECT_EQ(found->v, std::to_string(rnd));
+    }
+}
+
+TEST(SortedVector, Delete)
+{
+    auto vector = CreateVector(100);
+    const auto random_Selection = RandomSelection(vector.size(), 10);
+    for (const int rnd : random_Selection)
+    {
+        const auto found = vector.lower_bound(rnd);
+        vector.erase(found);
+    }
+    // check deleted items removed
+    for (const int rnd : random_Selection)
+        EXPECT_FALSE(Contains(vector, rnd));
+    // check size changed
+    EXPECT_EQ(vector.size(), 90);
+}
+
+TEST(SortedVector, MultiDelete)
+{
+    auto vector = CreateVector(100);
+    const auto random_selection = RandomSelection(vector.size(), 10);
+    vector.batch_erase(random_selection);
+    // check deleted items removed
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (const int rnd : random_selection)
+        EXPECT_FALSE(Contains(vector, rnd));
+    // check size changed
+    EXPECT_EQ(vector.size(), 90);
+}
+
+TEST(SortedVector, MagicDelete)
+{
+    auto vector = CreateVector(100);
+    const auto random_selection = RandomSelection(vector.size(), 10);
+    BatchDeleteWithMagic(vector, random_selection);
+    // check deleted items removed
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (const int rnd : random_selection)
+        EXPECT_FALSE(Contains(vector, rnd));
+    // check size changed
+    EXPECT_EQ(vector.size(), 90);
+}
+
+TEST(SortedVector, Insert)
+{
+    auto vector = CreateVector(100);
+    const auto random_selection = RandomSelection(vector.size(), 10);
+    vector.batch_erase(random_selection);
+    std::vector<Elem> new_elems{random_selection.size()};
+    std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                    { return Elem{r, std::to_string(r)}; });
+    vector.batch_insert(new_elems);
+   // check deleted items removed
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (const int rnd : random_selection)
+        EXPECT_TRUE(Contains(vector, rnd));
+    // check size changed
+    EXPECT_EQ(vector.size(), 100);
+}
+
+TEST(SortedVector, InsertMagic)
+{
+    auto vector = CreateVector(100);
+    const auto random_selection = RandomSelection(vector.size(), 10);
+    vector.batch_erase(random_selection);
+    std::vector<Elem> new_elems{random_selection.size()};
+    std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
+                    { return Elem{r, std::to_string(r)}; });
+    BatchInsertMagic(vector, new_elems);
+   // check deleted items removed
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (const int rnd : random_selection)
+        EXPECT_TRUE(Contains(vector, rnd));
+    // check size changed
+    EXPECT_EQ(vector.size(), 100);
+}
+TEST(SortedVector, FindAndEqualRange)
+{
+    const auto vector = CreateVector(100);
+    EXPECT_EQ(vector.find(42)->v, "42"s);
+    EXPECT_TRUE(vector.find(100) == vector.end());
+    EXPECT_TRUE(vector.contains(0));
+    EXPECT_FALSE(vector.contains(-1));
+    const auto [first, last] = vector.equal_range(42);
+    EXPECT_EQ(last - first, 1);
+    const auto [none_first, none_last] = vector.equal_range(100);
+    EXPECT_EQ(none_first, none_last);
+    EXPECT_EQ(vector.upper_bound(42) - vector.lower_bound(42), 1);
+}
+
+TEST(SortedVector, SingleInsertErase)
+{
+    auto vector = CreateVector(100);
+    EXPECT_EQ(vector.erase(42), 1);
+    EXPECT_EQ(vector.erase(42), 0);
+    EXPECT_TRUE(vector.insert(Elem{42, "new"}).second);
+    EXPECT_FALSE(vector.insert(Elem{42, "newer"}).second);
+    EXPECT_EQ(vector.find(42)->v, "new"s);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    EXPECT_EQ(vector.size(), 100);
+}
+
+TEST(SortedVector, InsertKeepsExisting)
+{
+    auto vector = CreateVector(100);
+    vector.batch_insert({Elem{10, "dup"}, Elem{200, "200"}, Elem{150, "150"}});
+    EXPECT_EQ(vector.find(10)->v, "10"s);
+    EXPECT_EQ(vector.find(150)->v, "150"s);
+    EXPECT_EQ(vector.size(), 102);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+}
+
+TEST(SortedVector, InsertAtEnds)
+{
+    auto vector = CreateVector(100);
+    vector.batch_erase({0, 1, 50});
+    vector.batch_insert({Elem{99, "dup"}, Elem{0, "0"}, Elem{50, "50"}, Elem{1000, "1000"}, Elem{-5, "-5"}, Elem{-5, "-5"}});
+    EXPECT_EQ(vector.size(), 101);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    EXPECT_EQ(vector.nth(0)->k, -5);
+    EXPECT_EQ(vector.nth(100)->k, 1000);
+    EXPECT_EQ(vector.find(99)->v, "99"s);
+    EXPECT_FALSE(vector.contains(1));
+    MyVector empty;
+    empty.batch_insert({Elem{3, "3"}, Elem{1, "1"}});
+    EXPECT_EQ(empty.nth(0)->k, 1);
+    EXPECT_EQ(empty.size(), 2);
+}
+
+TEST(SortedVector, MultiDeleteMissingAndTail)
+{
+    auto vector = CreateVector(100);
+    EXPECT_EQ(vector.batch_erase({99, 0, 1000, 98, 50, 50, -1}), 4);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (const int rnd : {0, 50, 98, 99})
         EXPECT_FALSE(Contains(vector, rnd));
-    // check size changed
-    EXPECT_EQ(vector.size(), 90);
+    EXPECT_EQ(vector.size(), 96);
+    EXPECT_EQ(vector.nth(95)->k, 97);
+    EXPECT_EQ(vector.batch_erase({1000}), 0);
+    EXPECT_EQ(vector.size(), 96);
 }
 
-TEST(SortedVector, Insert)
+TEST(SortedVector, DeleteRangeAndPredicate)
 {
     auto vector = CreateVector(100);
-    const auto random_selection = RandomSelection(vector.size(), 10);
-    BatchDelete(vector, random_selection);
+    EXPECT_EQ(vector.erase_range(10, 20), 10);
+    EXPECT_FALSE(Contains(vector, 10));
+    EXPECT_FALSE(Contains(vector, 19));
+    EXPECT_TRUE(Contains(vector, 20));
+    EXPECT_EQ(erase_if(vector, [](const Elem &e) { return e.k % 2 == 1; }), 45);
+    EXPECT_EQ(vector.size(), 45);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    EXPECT_TRUE(std::all_of(vector.begin(), vector.end(), [](const Elem &e) { return e.k % 2 == 0; }));
+}
+
+TEST(SortedVector, EytzingerLookup)
+{
+    // every position, including misses before, between and after the keys
+    auto vector = CreateVector(100);
+    vector.batch_erase({0, 10, 11, 99});
+    for (int size : {0, 1, 2, 7, 8, 96})
+    {
+        MyVector part{vector.begin(), vector.begin() + std::min<int>(size, vector.size())};
+        const eytzinger_index<int> index{part};
+        for (int key = -1; key <= 100; ++key)
+            EXPECT_EQ(index.lower_bound(key), part.lower_bound(key) - part.begin());
+    }
+}
+
+TEST(SortedVector, EytzingerRebuiltOnUpdate)
+{
+    MyIndexedVector vector{CreateVector(100)};
+    vector.batch_erase({5, 6, 7});
+    EXPECT_FALSE(vector.contains(6));
+    EXPECT_EQ(vector.lower_bound(6)->k, 8);
+    vector.batch_insert({Elem{6, "6"}, Elem{200, "200"}});
+    EXPECT_EQ(vector.find(6)->v, "6"s);
+    EXPECT_EQ(vector.find(200)->v, "200"s);
+    EXPECT_TRUE(vector.find(5) == vector.end());
+}
+
+// every kernel this cpu can run, against std::lower_bound, for every key position
+template<class T>
+static void CheckKernels(const std::vector<T> &keys, std::size_t stride, const T *first)
+{
+    for (int lvl = 0; lvl <= static_cast<int>(simd_search::best_level()); ++lvl)
+    {
+        for (T key = -1; key <= T(2 * keys.size() + 1); ++key)
+        {
+            const auto expected = std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+            EXPECT_EQ(simd_search::lower_bound(simd_search::level(lvl), first, keys.size(), stride, key), expected)
+                << "level " << lvl << " size " << keys.size() << " key " << key;
+        }
+    }
+}
+
+TEST(SortedVector, SimdLowerBound)
+{
+    for (int size : {0, 1, 15, 16, 17, 31, 33, 100, 257})
+    {
+        // odd keys only, so misses fall between every pair
+        std::vector<int> keys32(size);
+        std::vector<std::int64_t> keys64(size);
+        for (int i = 0; i < size; ++i)
+        {
+            keys32[i] = 2 * i + 1;
+            keys64[i] = 2 * i + 1;
+        }
+        CheckKernels(keys32, sizeof(int), keys32.data());
+        CheckKernels(keys64, sizeof(std::int64_t), keys64.data());
+        // strided, through the vector itself
+        MyVector::container_type elems;
+        for (int key : keys32)
+            elems.push_back(Elem{key, std::to_string(key)});
+        const MyVector vector{std::move(elems)};
+        if (size)
+            CheckKernels(keys32, sizeof(Elem), &vector.begin()->k);
+    }
+}
+
+TEST(SortedVector, ScalarKeyLookup)
+{
+    // not a SIMD key type, goes through the branchless scalar kernel
+    sorted_vector<double, int>::container_type elems;
+    for (int i = 0; i < 100; ++i)
+        elems.push_back({i * 0.5, i});
+    const sorted_vector<double, int> vector{std::move(elems)};
+    EXPECT_EQ(vector.find(10.0)->v, 20);
+    EXPECT_EQ(vector.lower_bound(10.25)->v, 21);
+    EXPECT_TRUE(vector.lower_bound(100.0) == vector.end());
+    EXPECT_TRUE(vector.lower_bound(-1.0) == vector.begin());
+}
+
+TEST(SortedColumns, CreateAndLookup)
+{
+    const auto columns = CreateColumns(100);
+    EXPECT_EQ(columns.size(), 100);
+    EXPECT_EQ(columns.nth(0)->v, "0"s);
+    EXPECT_EQ(columns.nth(99)->v, "99"s);
+    EXPECT_TRUE(std::is_sorted(columns.keys().begin(), columns.keys().end()));
+    for (const int rnd : RandomSelection(columns.size(), 10))
+        EXPECT_EQ(columns.lower_bound(rnd)->v, std::to_string(rnd));
+    EXPECT_TRUE(columns.find(100) == columns.end());
+    const auto [first, last] = columns.equal_range(42);
+    EXPECT_EQ(last - first, 1);
+}
+
+TEST(SortedColumns, BatchInsertDelete)
+{
+    auto columns = CreateColumns(100);
+    const auto random_selection = RandomSelection(columns.size(), 10);
+    EXPECT_EQ(columns.batch_erase(random_selection), 10);
+    EXPECT_EQ(columns.size(), 90);
+    for (const int rnd : random_selection)
+        EXPECT_FALSE(columns.contains(rnd));
     std::vector<Elem> new_elems{random_selection.size()};
     std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
                     { return Elem{r, std::to_string(r)}; });
-    BatchInsert(vector, new_elems);
-   // check deleted items removed
-    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end()));
-    for (const int rnd : random_selection)
-        EXPECT_TRUE(Contains(vector, rnd));
-    // check size changed
-    EXPECT_EQ(vector.size(), 100);
+    new_elems.push_back(Elem{0, "dup"});
+    columns.batch_insert(new_elems);
+    EXPECT_EQ(columns.size(), 100);
+    EXPECT_TRUE(std::is_sorted(columns.keys().begin(), columns.keys().end()));
+    // values moved with their keys
+    for (const auto entry : columns)
+        EXPECT_EQ(entry.v, std::to_string(entry.k % 100));
+    EXPECT_EQ(columns.erase_range(10, 20), 10);
+    EXPECT_EQ(columns.erase(50), 1);
+    EXPECT_TRUE(columns.insert(Elem{50, "50"}).second);
+    EXPECT_EQ(columns.find(50)->v, "50"s);
+    EXPECT_EQ(columns.size(), 90);
 }
 
-TEST(SortedVector, InsertMagic)
+TEST(SortedColumns, BatchInsertArenaValues)
+{
+    // values with a stateful allocator can't be merged into empty slots, the columns are rebuilt
+    using ArenaColumns = sorted_columns<int, std::pmr::string, std::less<int>, std::allocator<int>,
+                                        std::pmr::polymorphic_allocator<std::pmr::string>>;
+    std::vector<ArenaColumns::value_type> elems;
+    for (int key = 0; key < 100; key += 2)
+        elems.push_back({key, std::pmr::string(std::to_string(key))});
+    ArenaColumns columns{std::move(elems)};
+    std::vector<ArenaColumns::value_type> batch;
+    for (const int key : {101, 7, 8, -1, 7, 55})
+        batch.push_back({key, std::pmr::string(std::to_string(key))});
+    batch.back().v = "a long string, too long for the small string buffer";
+    columns.batch_insert(std::move(batch));
+    EXPECT_EQ(columns.size(), 54);
+    EXPECT_TRUE(std::is_sorted(columns.keys().begin(), columns.keys().end()));
+    for (const auto entry : columns)
+        if (entry.k != 55)
+        {
+            EXPECT_EQ(std::string_view(entry.v), std::to_string(entry.k));
+        }
+    EXPECT_EQ(std::string_view(columns.find(55)->v), "a long string, too long for the small string buffer");
+}
+
+TEST(SortedVector, FindMany)
 {
     auto vector = CreateVector(100);
-    const auto random_selection = RandomSelection(vector.size(), 10);
-    BatchDelete(vector, random_selection);
+    vector.batch_erase({3, 4, 60});
+    const std::vector<int> queries{60, 99, 0, 3, 42, 1000, 42, -1, 5};
+    const auto positions = vector.find_many(queries);
+    ASSERT_EQ(positions.size(), queries.size());
+    for (std::size_t i = 0; i < queries.size(); ++i)
+        EXPECT_EQ(vector.nth(positions[i]), vector.find(queries[i])) << queries[i];
+    const auto columns = CreateColumns(100);
+    const auto column_positions = columns.find_many(queries);
+    for (std::size_t i = 0; i < queries.size(); ++i)
+        EXPECT_EQ(columns.nth(column_positions[i]), columns.find(queries[i])) << queries[i];
+}
+
+TEST(SortedVector, ParallelSortSplitsMerges)
+{
+    // duplicate keys, and thread counts that leave runs without a partner in some rounds
+    std::mt19937 rng(5);
+    std::vector<Elem> input(200000);
+    for (auto &elem : input)
+    {
+        elem.k = int(rng() % 50000);
+        elem.v = std::to_string(elem.k) + " and a value too long for the small string buffer";
+    }
+    auto expected = input;
+    std::sort(expected.begin(), expected.end(), [](const Elem &a, const Elem &b) { return a.k < b.k; });
+    for (unsigned threads : {2u, 3u, 5u, 8u})
+    {
+        thread_pool pool(threads);
+        auto sorted = input;
+        parallel_sort(sorted.begin(), sorted.end(), [](const Elem &a, const Elem &b) { return a.k < b.k; }, pool);
+        ASSERT_TRUE(std::equal(sorted.begin(), sorted.end(), expected.begin(),
+                               [](const Elem &a, const Elem &b) { return a.k == b.k && a.v == b.v; })) << threads;
+    }
+}
+
+TEST(SortedVector, ParallelCreate)
+{
+    for (unsigned threads : {1u, 3u, 4u})
+    {
+        thread_pool pool(threads);
+        const auto vector = CreateVector(1 << 17, pool);
+        EXPECT_EQ(vector.size(), 1 << 17);
+        EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+        EXPECT_EQ(vector.nth(12345)->k, 12345);
+        EXPECT_EQ(vector.nth(12345)->v, "45"s);
+    }
+}
+
+TEST(SortedVector, RadixSort)
+{
+    // signed keys either side of zero, repeated keys stay in their original order
+    std::vector<sorted_entry<int, int>> elems;
+    for (int i = 0; i < 5000; ++i)
+        elems.push_back({(i * 7919) % 2001 - 1000, i});
+    auto expected = elems;
+    std::stable_sort(expected.begin(), expected.end(), [](const auto &a, const auto &b) { return a.k < b.k; });
+    radix_sort(elems, [](const auto &e) { return e.k; });
+    for (std::size_t i = 0; i < elems.size(); ++i)
+    {
+        EXPECT_EQ(elems[i].k, expected[i].k);
+        EXPECT_EQ(elems[i].v, expected[i].v);
+    }
+    std::vector<sorted_entry<std::int64_t, int>> wide;
+    for (int i = 0; i < 3000; ++i)
+        wide.push_back({(std::int64_t(i) * 1000003 % 3001 - 1500) << 33, i});
+    radix_sort(wide, [](const auto &e) { return e.k; });
+    EXPECT_TRUE(std::is_sorted(wide.begin(), wide.end(), [](const auto &a, const auto &b) { return a.k < b.k; }));
+}
+
+TEST(SortedVector, RadixCreate)
+{
+    // big enough for the radix path, values must still match keys
+    const auto vector = CreateVector(10000);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (int i : {0, 1234, 9999})
+        EXPECT_EQ(vector.nth(i)->v, std::to_string(i % 100));
+}
+
+TEST(LsmSortedVector, SingleInserts)
+{
+    MyLsmVector lsm{16};
+    std::vector<int> nums(1000);
+    std::iota(nums.begin(), nums.end(), 0);
+    std::random_shuffle(nums.begin(), nums.end());
+    for (const int num : nums)
+        EXPECT_TRUE(lsm.insert(Elem{num, std::to_string(num)}));
+    EXPECT_FALSE(lsm.insert(Elem{7, "dup"}));
+    EXPECT_EQ(lsm.size(), 1000);
+    // runs stay logarithmic
+    EXPECT_LE(lsm.run_count(), 10);
+    for (const int num : {0, 7, 500, 999})
+        EXPECT_EQ(lsm.find(num)->v, std::to_string(num));
+    EXPECT_TRUE(lsm.find(1000) == nullptr);
+    EXPECT_EQ(lsm.erase(500), 1);
+    EXPECT_EQ(lsm.erase(500), 0);
+    EXPECT_FALSE(lsm.contains(500));
+    const auto &flat = lsm.compact();
+    EXPECT_EQ(lsm.run_count(), 1);
+    EXPECT_EQ(flat.size(), 999);
+    EXPECT_TRUE(std::is_sorted(flat.begin(), flat.end(), flat.value_comp()));
+}
+
+TEST(LsmSortedVector, FromVector)
+{
+    auto vector = CreateVector(100);
+    vector.batch_erase({10, 20, 30});
+    MyLsmVector lsm{std::move(vector), 2};
+    EXPECT_TRUE(lsm.insert(Elem{20, "20"}));
+    EXPECT_FALSE(lsm.insert(Elem{21, "dup"}));
+    EXPECT_TRUE(lsm.insert(Elem{10, "10"}));
+    EXPECT_EQ(lsm.find(21)->v, "21"s);
+    EXPECT_EQ(lsm.find(10)->v, "10"s);
+    EXPECT_FALSE(lsm.contains(30));
+    EXPECT_EQ(lsm.size(), 99);
+}
+
+TEST(TombstoneSortedVector, DeleteSkipsDead)
+{
+    MyTombstoneVector vector{CreateVector(100)};
+    for (const int rnd : {10, 11, 12, 63, 64, 99})
+        EXPECT_EQ(vector.erase(rnd), 1);
+    EXPECT_EQ(vector.erase(10), 0);
+    EXPECT_EQ(vector.size(), 94);
+    EXPECT_EQ(vector.dead_slots(), 6);
+    EXPECT_FALSE(vector.contains(11));
+    EXPECT_EQ(vector.lower_bound(10)->k, 13);
+    EXPECT_EQ(vector.lower_bound(63)->k, 65);
+    EXPECT_TRUE(vector.lower_bound(99) == vector.end());
+    EXPECT_EQ(std::distance(vector.begin(), vector.end()), 94);
+    // revive a dead slot in place
+    EXPECT_TRUE(vector.insert(Elem{11, "eleven"}));
+    EXPECT_EQ(vector.find(11)->v, "eleven"s);
+    EXPECT_EQ(vector.dead_slots(), 5);
+    vector.compact();
+    EXPECT_EQ(vector.dead_slots(), 0);
+    EXPECT_EQ(vector.capacity_used(), 95);
+    EXPECT_EQ(vector.find(11)->v, "eleven"s);
+}
+
+TEST(TombstoneSortedVector, InlineCompaction)
+{
+    MyTombstoneVector vector{CreateVector(100), nullptr, 0.1};
+    for (int i = 0; i < 50; ++i)
+        vector.erase(2 * i);
+    EXPECT_EQ(vector.size(), 50);
+    EXPECT_LT(vector.capacity_used(), 60);
+    for (int i = 0; i < 100; ++i)
+        EXPECT_EQ(vector.contains(i), i % 2 == 1);
+}
+
+TEST(TombstoneSortedVector, BackgroundCompaction)
+{
+    thread_pool pool(2);
+    MyTombstoneVector vector{CreateVector(10000), &pool, 0.1};
+    for (int i = 0; i < 5000; ++i)
+        vector.erase(2 * i);
+    vector.wait();
+    EXPECT_EQ(vector.size(), 5000);
+    EXPECT_LT(vector.capacity_used(), 10000);
+    for (int i = 0; i < 10000; ++i)
+        ASSERT_EQ(vector.contains(i), i % 2 == 1) << i;
+    vector.batch_insert({Elem{0, "0"}, Elem{20000, "20000"}});
+    EXPECT_EQ(vector.size(), 5002);
+    EXPECT_EQ(vector.dead_slots(), 0);
+}
+
+TEST(SortedVector, ArenaValues)
+{
+    std::pmr::monotonic_buffer_resource arena;
+    auto vector = CreatePmrVector(5000, &arena);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    EXPECT_EQ(vector.find(1234)->v, "34");
+    // batch updates keep the values where they were
+    vector.batch_erase({1, 2, 3});
+    std::vector<sorted_entry<int, std::pmr::string>> batch;
+    batch.push_back({2, std::pmr::string("a long string, too long for the small string buffer", &arena)});
+    vector.batch_insert(std::move(batch));
+    EXPECT_EQ(vector.find(2)->v.get_allocator().resource(), &arena);
+    EXPECT_EQ(vector.find(4000)->v.get_allocator().resource(), &arena);
+    EXPECT_EQ(vector.get_allocator().resource(), &arena);
+}
+
+TEST(SortedVector, PooledValues)
+{
+    string_pool pool;
+    const auto vector = CreatePooledVector(1000, pool);
+    EXPECT_EQ(pool.size(), 100);
+    EXPECT_EQ(sizeof(MyPooledVector::value_type), 8);
+    EXPECT_EQ(pool.view(vector.find(123)->v), "23");
+    EXPECT_EQ(vector.find(23)->v, vector.find(123)->v);
+    const std::string big(100000, 'x');
+    EXPECT_EQ(pool.view(pool.intern(big)), big);
+    EXPECT_EQ(pool.view(pool.intern("after")), "after");
+}
+
+TEST(SortedVector, BatchCycleDoesNotAllocate)
+{
+    auto vector = CreateVector(10000);
+    // big enough batch for the radix path too
+    const auto random_selection = RandomSelection(vector.size(), 3000);
+    // values too long for the small string buffer, so copying one allocates
     std::vector<Elem> new_elems{random_selection.size()};
     std::transform(random_selection.begin(), random_selection.end(), new_elems.begin(), [](int r)
-                    { return Elem{r, std::to_string(r)}; });
-    BatchInsertMagic(vector, new_elems);
-   // check deleted items removed
-    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end()));
-    for (const int rnd : random_selection)
-        EXPECT_TRUE(Contains(vector, rnd));
-    // check size changed
-    EXPECT_EQ(vector.size(), 100);
-}
\ No newline at end of file
+                    { return Elem{r, std::to_string(r) + " is a value that lives on the heap"}; });
+    std::vector<MyVector::size_type> positions(random_selection.size());
+    MyVector::scratch work;
+    std::vector<Elem> batch;
+    // first cycle grows the container and the scratch buffers
+    vector.batch_erase(random_selection, work);
+    batch = new_elems;
+    vector.batch_insert(std::move(batch), work);
+    vector.find_many(random_selection, positions, work);
+    // only the container calls are counted, making the batch's strings is the caller's business
+    std::size_t allocated = 0;
+    for (int cycle = 0; cycle < 3; ++cycle)
+    {
+        batch.assign(new_elems.begin(), new_elems.end());
+        const std::size_t before = allocations;
+        EXPECT_EQ(vector.batch_erase(random_selection, work), random_selection.size());
+        vector.batch_insert(std::move(batch), work);
+        vector.find_many(random_selection, positions, work);
+        allocated += allocations - before;
+    }
+    EXPECT_EQ(allocated, 0);
+    EXPECT_EQ(vector.size(), 10000);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    for (std::size_t i = 0; i < random_selection.size(); ++i)
+    {
+        EXPECT_EQ(vector.nth(positions[i])->k, random_selection[i]);
+        EXPECT_EQ(vector.nth(positions[i])->v, new_elems[i].v);
+    }
+}
+
+TEST(SortedVector, MoveSinkAndSortedErase)
+{
+    auto vector = CreateVector(100);
+    MyVector::scratch work;
+    EXPECT_EQ(vector.batch_erase_sorted(std::vector<int>{5, 6, 7, 200}), 3);
+    std::vector<Elem> batch{Elem{7, "7"}, Elem{5, "5"}};
+    vector.batch_insert(std::move(batch), work);
+    EXPECT_EQ(vector.size(), 99);
+    EXPECT_TRUE(vector.contains(5));
+    EXPECT_FALSE(vector.contains(6));
+}
+
+TEST(MappedSortedVector, SaveAndOpen)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "sorted_vector_test.bin").string();
+    auto vector = CreateVector(1000);
+    vector.batch_erase({10, 11, 12});
+    for (const bool with_index : {true, false})
+    {
+        save(vector, path, with_index);
+        const MyMappedVector mapped{path};
+        EXPECT_EQ(mapped.has_index(), with_index);
+        ASSERT_EQ(mapped.size(), vector.size());
+        for (const int rnd : RandomSelection(1000, 100))
+        {
+            const auto found = mapped.lower_bound(rnd);
+            EXPECT_EQ(found, std::size_t(vector.lower_bound(rnd) - vector.begin()));
+            EXPECT_EQ(mapped.contains(rnd), vector.contains(rnd));
+        }
+        EXPECT_EQ(mapped.value(mapped.find(999)), "99");
+        EXPECT_EQ(mapped.find(11), mapped.size());
+        EXPECT_EQ(mapped.lower_bound(-5), 0);
+        EXPECT_EQ(mapped.lower_bound(5000), mapped.size());
+        std::vector<int> scanned;
+        mapped.scan(8, 15, [&](int key, std::string_view value) {
+            scanned.push_back(key);
+            EXPECT_EQ(value, std::to_string(key));
+        });
+        EXPECT_EQ(scanned, (std::vector<int>{8, 9, 13, 14}));
+    }
+    std::filesystem::remove(path);
+}
+
+TEST(MappedSortedVector, RejectsBadFiles)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "sorted_vector_bad.bin").string();
+    std::ofstream(path) << "not a sorted vector, but long enough to hold a header, honestly it is";
+    EXPECT_THROW(MyMappedVector{path}, std::runtime_error);
+    save(CreateVector(10), path);
+    EXPECT_THROW(mapped_sorted_vector<long long>{path}, std::runtime_error);
+
+    // corrupt copies of a good file: header fields pointing outside the file, or misaligned
+    save(CreateVector(1000), path);
+    const auto corrupt = [&path](std::size_t field, std::uint64_t value) {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        mapped_format::header h;
+        file.read(reinterpret_cast<char *>(&h), sizeof(h));
+        const auto original = *reinterpret_cast<std::uint64_t *>(reinterpret_cast<char *>(&h) + field);
+        std::memcpy(reinterpret_cast<char *>(&h) + field, &value, sizeof(value));
+        file.seekp(0);
+        file.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        file.close();
+        EXPECT_THROW(MyMappedVector{path}, std::runtime_error) << field << " = " << value;
+        std::fstream restore(path, std::ios::binary | std::ios::in | std::ios::out);
+        restore.seekp(field);
+        restore.write(reinterpret_cast<const char *>(&original), sizeof(original));
+    };
+    corrupt(offsetof(mapped_format::header, count), 1000000);
+    corrupt(offsetof(mapped_format::header, count), UINT64_MAX);
+    corrupt(offsetof(mapped_format::header, keys_offset), 65);
+    corrupt(offsetof(mapped_format::header, offsets_offset), UINT64_MAX - 63);
+    corrupt(offsetof(mapped_format::header, heap_size), 1);
+    corrupt(offsetof(mapped_format::header, heap_size), 1ULL << 40);
+    corrupt(offsetof(mapped_format::header, sample_count), 1000);
+    EXPECT_EQ(MyMappedVector{path}.size(), 1000);
+    // a bad offset in the middle is caught when its value is read
+    {
+        std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+        mapped_format::header h;
+        file.read(reinterpret_cast<char *>(&h), sizeof(h));
+        const std::uint64_t bad = 1ULL << 40;
+        file.seekp(h.offsets_offset + 500 * sizeof(std::uint64_t));
+        file.write(reinterpret_cast<const char *>(&bad), sizeof(bad));
+    }
+    {
+        const MyMappedVector mapped{path};
+        EXPECT_THROW(mapped.value(499), std::runtime_error);
+        EXPECT_THROW(mapped.value(500), std::runtime_error);
+        EXPECT_EQ(mapped.value(501), "1");
+    }
+    // and a truncated file
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+    EXPECT_THROW(MyMappedVector{path}, std::runtime_error);
+    std::filesystem::remove(path);
+    EXPECT_THROW(MyMappedVector{path}, std::system_error);
+}
+
+TEST(ExternalSortBuilder, SpillsAndMerges)
+{
+    // 4KB holds ~60 records, so 10000 records make more runs than one merge takes
+    MyExternalBuilder builder(4096);
+    for (auto &elem : ShuffledElems(10000))
+        builder.add(std::move(elem));
+    builder.add(42, "42");
+    EXPECT_GT(builder.run_count(), MyExternalBuilder::max_merge_width);
+    const auto vector = builder.finish();
+    EXPECT_EQ(vector.size(), 10000);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    EXPECT_EQ(vector.nth(0)->k, 0);
+    EXPECT_EQ(vector.nth(9999)->k, 9999);
+    EXPECT_EQ(vector.nth(1234)->v, "34");
+    EXPECT_EQ(builder.run_count(), 0);
+}
+
+TEST(ExternalSortBuilder, ToMappedFile)
+{
+    const auto path = (std::filesystem::temp_directory_path() / "sorted_vector_ext_test.bin").string();
+    MyExternalBuilder builder(4096);
+    for (auto &elem : ShuffledElems(1000))
+        builder.add(std::move(elem));
+    builder.finish(path);
+    const MyMappedVector mapped{path};
+    EXPECT_EQ(mapped.size(), 1000);
+    for (const int rnd : RandomSelection(1000, 100))
+        EXPECT_EQ(mapped.value(mapped.find(rnd)), std::to_string(rnd % 100));
+    std::filesystem::remove(path);
+
+    // small enough to never touch the disk
+    MyExternalBuilder in_memory;
+    in_memory.add(3, "three");
+    in_memory.add(1, "one");
+    EXPECT_EQ(in_memory.run_count(), 0);
+    const auto vector = in_memory.finish();
+    EXPECT_EQ(vector.nth(0)->v, "one");
+}
+
+TEST(ExternalSortBuilder, TruncatedRunThrows)
+{
+    // a run cut short in the middle of a record is an error, not the end of the run
+    const auto dir = std::filesystem::temp_directory_path() / "sorted_vector_ext_truncated";
+    std::filesystem::create_directories(dir);
+    {
+        MyExternalBuilder builder(4096, dir);
+        for (auto &elem : ShuffledElems(1000))
+            builder.add(std::move(elem));
+        ASSERT_GT(builder.run_count(), 0);
+        for (const auto &run : std::filesystem::directory_iterator(dir))
+            std::filesystem::resize_file(run.path(), std::filesystem::file_size(run.path()) - 3);
+        EXPECT_THROW(builder.finish(), std::runtime_error);
+    }
+    std::filesystem::remove_all(dir);
+}
+
+TEST(ConcurrentSortedVector, SnapshotIsolation)
+{
+    MyConcurrentVector table{CreateVector(10000), 256};
+    MyConcurrentVector::reader reader{table};
+    {
+        const auto before = reader.read();
+        EXPECT_EQ(table.batch_erase({5, 500, 5000, 20000}), 3);
+        table.batch_insert({Elem{20000, "new"}, Elem{5, "5"}});
+        // the old snapshot still sees the old contents, and pins the versions since
+        EXPECT_TRUE(before.contains(500));
+        EXPECT_FALSE(before.contains(20000));
+        EXPECT_EQ(before.size(), 10000);
+        EXPECT_EQ(table.retired_versions(), 2);
+
+        // a second snapshot from the same reader, while the first is alive
+        {
+            const auto after = reader.read();
+            EXPECT_FALSE(after.contains(500));
+            EXPECT_EQ(after.find(20000)->v, "new");
+            EXPECT_EQ(after.find(5)->v, "5");
+            EXPECT_EQ(after.size(), 9999);
+            std::vector<int> scanned;
+            after.scan(4998, 5003, [&](const Elem &elem) { scanned.push_back(elem.k); });
+            EXPECT_EQ(scanned, (std::vector<int>{4998, 4999, 5001, 5002}));
+        }
+        // dropping it doesn't release the first one's versions
+        table.batch_erase({6});
+        table.collect();
+        EXPECT_EQ(table.retired_versions(), 3);
+        EXPECT_TRUE(before.contains(500));
+        EXPECT_TRUE(before.contains(6));
+        EXPECT_EQ(before.size(), 10000);
+    }
+    table.collect();
+    EXPECT_EQ(table.retired_versions(), 0);
+}
+
+TEST(ConcurrentSortedVector, ReadersDuringUpdates)
+{
+    MyConcurrentVector table{CreateVector(20000), 256};
+    std::atomic<bool> stop{false};
+    std::atomic<int> misses{0};
+    std::thread reader_thread([&] {
+        MyConcurrentVector::reader reader{table};
+        while (!stop)
+        {
+            // odd keys are never touched by the writer
+            const auto snapshot = reader.read();
+            for (int key = 1; key < 20000; key += 98)
+                if (!snapshot.contains(key))
+                    ++misses;
+        }
+    });
+    std::vector<int> evens;
+    std::vector<Elem> elems;
+    for (int key = 0; key < 20000; key += 2)
+    {
+        evens.push_back(key);
+        elems.push_back(Elem{key, std::to_string(key % 100)});
+    }
+    for (int round = 0; round < 20; ++round)
+    {
+        EXPECT_EQ(table.batch_erase(evens), evens.size());
+        table.batch_insert(elems);
+    }
+    stop = true;
+    reader_thread.join();
+    EXPECT_EQ(misses, 0);
+    MyConcurrentVector::reader reader{table};
+    EXPECT_EQ(reader.read().size(), 20000);
+    table.collect();
+    EXPECT_EQ(table.retired_versions(), 0);
+}
+
+TEST(ShardedSortedVector, BatchOps)
+{
+    thread_pool pool(4);
+    MyShardedVector vector{CreateVector(10000), pool, 8};
+    EXPECT_EQ(vector.shard_count(), 8);
+    const auto random_selection = RandomSelection(10000, 5000);
+    EXPECT_EQ(vector.batch_erase(random_selection), 5000);
+    EXPECT_EQ(vector.size(), 5000);
+    std::vector<Elem> new_elems;
+    for (const int r : random_selection)
+        new_elems.push_back(Elem{r, std::to_string(r % 100)});
+    vector.batch_insert(new_elems);
+    EXPECT_EQ(vector.size(), 10000);
+    std::vector<int> keys;
+    vector.for_each([&](const Elem &elem) { keys.push_back(elem.k); });
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+    const std::vector<int> lookups{7, 20000, 9999, -1};
+    const auto found = vector.find_many(lookups);
+    EXPECT_EQ(found[0]->v, "7");
+    EXPECT_EQ(found[1], nullptr);
+    EXPECT_EQ(found[2]->k, 9999);
+    EXPECT_EQ(found[3], nullptr);
+}
+
+TEST(ShardedSortedVector, Rebalance)
+{
+    thread_pool pool(2);
+    MyShardedVector vector{CreateVector(16 * 1024), pool, 4};
+    // everything lands past the last bound, in the last shard
+    std::vector<Elem> skewed;
+    for (int key = 16 * 1024; key < 64 * 1024; ++key)
+        skewed.push_back(Elem{key, std::to_string(key % 100)});
+    vector.batch_insert(skewed);
+    EXPECT_EQ(vector.shard_count(), 4);
+    EXPECT_EQ(vector.size(), 64 * 1024);
+    for (std::size_t i = 0; i < vector.shard_count(); ++i)
+        EXPECT_LE(vector.shard(i).size(), 2 * vector.size() / vector.shard_count());
+    for (const int key : {0, 16 * 1024, 40000, 64 * 1024 - 1})
+        EXPECT_TRUE(vector.contains(key));
+    std::vector<int> keys;
+    vector.for_each([&](const Elem &elem) { keys.push_back(elem.k); });
+    EXPECT_TRUE(std::is_sorted(keys.begin(), keys.end()));
+}
+
+TEST(SearchIndex, ExactOnEveryLayout)
+{
+    for (const Keys layout : {Keys::uniform, Keys::clustered, Keys::zipf})
+    {
+        const auto keys = DistributedKeys(50000, layout);
+        const MyVector plain{CreateDistributedVector(keys)};
+        const MyInterpolationVector interpolated{CreateDistributedVector(keys)};
+        const MyLearnedVector learned{CreateDistributedVector(keys)};
+        EXPECT_LT(learned.search_index().segment_count(), keys.size() / 64);
+        // every key, and the gaps either side of it
+        for (std::size_t i = 0; i < keys.size(); i += 7)
+            for (const int key : {keys[i] - 1, keys[i], keys[i] + 1})
+            {
+                const auto expected = plain.lower_bound(key) - plain.begin();
+                EXPECT_EQ(interpolated.lower_bound(key) - interpolated.begin(), expected);
+                EXPECT_EQ(learned.lower_bound(key) - learned.begin(), expected);
+            }
+        EXPECT_EQ(learned.lower_bound(keys.back() + 100), learned.end());
+        EXPECT_EQ(interpolated.lower_bound(keys.back() + 100), interpolated.end());
+    }
+}
+
+TEST(SearchIndex, LearnedIncrementalUpdate)
+{
+    const auto keys = DistributedKeys(50000, Keys::zipf);
+    MyLearnedVector vector{CreateDistributedVector(keys)};
+    // a burst of new keys in one corner, and a block of deletes in another
+    std::vector<Elem> burst;
+    for (int key = keys[1000] + 1; key < keys[1000] + 5000; key += 3)
+        if (!std::binary_search(keys.begin(), keys.end(), key))
+            burst.push_back(Elem{key, "new"});
+    vector.batch_insert(burst);
+    vector.batch_erase(std::vector<int>(keys.begin() + 30000, keys.begin() + 31000));
+    vector.erase_range(keys[40000], keys[40100]);
+
+    const learned_index<int> rebuilt{vector.container()};
+    EXPECT_LE(vector.search_index().segment_count(), 2 * rebuilt.segment_count());
+    const auto &plain = vector.container();
+    for (std::size_t i = 0; i < plain.size(); i += 3)
+    {
+        const int key = plain.nth(i)->k;
+        EXPECT_EQ(vector.lower_bound(key) - vector.begin(), i);
+        EXPECT_EQ(vector.lower_bound(key + 1) - vector.begin(), plain.lower_bound(key + 1) - plain.begin());
+    }
+}
+
+TEST(SearchIndex, OverColumns)
+{
+    // sorted_columns has proxy iterators over two arrays, the indexes fall back to std::lower_bound
+    const auto columns = CreateColumns(5000);
+    const interpolation_index<int> interpolation;
+    const learned_index<int> learned{columns};
+    for (int key = -1; key <= 5000; key += 7)
+    {
+        const std::size_t expected = columns.lower_bound(key) - columns.begin();
+        EXPECT_EQ(interpolation.lower_bound(columns, key), expected) << key;
+        EXPECT_EQ(learned.lower_bound(columns, key), expected) << key;
+    }
+}
+
+TEST(SearchIndex, InterpolationOnBigKeys)
+{
+    // consecutive keys above 2^53 round to the same double, the guess has no span to work with
+    using BigVector = sorted_vector<std::int64_t, int>;
+    const std::int64_t base = std::int64_t(1) << 60;
+    BigVector::container_type elems;
+    for (int i = 0; i < 100; ++i)
+        elems.push_back({base + i, i});
+    const BigVector vector{sorted_unique, std::move(elems)};
+    const interpolation_index<std::int64_t> interpolation;
+    for (std::int64_t key = base - 1; key <= base + 100; ++key)
+    {
+        const std::size_t expected = vector.lower_bound(key) - vector.begin();
+        EXPECT_EQ(interpolation.lower_bound(vector, key), expected) << key - base;
+    }
+}
+
+TEST(BloomFilter, NoFalseNegatives)
+{
+    blocked_bloom_filter<int> filter(10000);
+    for (int key = 0; key < 10000; ++key)
+        filter.insert(key);
+    for (int key = 0; key < 10000; ++key)
+        EXPECT_TRUE(filter.may_contain(key));
+    int false_positives = 0;
+    for (int key = 10000; key < 110000; ++key)
+        false_positives += filter.may_contain(key);
+    EXPECT_LT(false_positives, 2000);
+}
+
+TEST(BloomFilter, FilteredVectorFollowsBatches)
+{
+    MyFilteredVector vector{CreateVector(10000)};
+    EXPECT_TRUE(vector.contains(42));
+    EXPECT_FALSE(vector.contains(20000));
+    std::vector<Elem> new_elems;
+    for (int key = 20000; key < 30000; ++key)
+        new_elems.push_back(Elem{key, std::to_string(key % 100)});
+    vector.batch_insert(new_elems);
+    for (int key = 20000; key < 30000; key += 37)
+        EXPECT_EQ(vector.find(key)->v, std::to_string(key % 100));
+    // enough erases to go stale and refill, the answers must not change
+    const auto random_selection = RandomSelection(10000, 8000);
+    EXPECT_EQ(vector.batch_erase(random_selection), 8000);
+    for (const int key : random_selection)
+        EXPECT_FALSE(vector.contains(key));
+    for (int key = 0; key < 10000; ++key)
+        EXPECT_EQ(vector.contains(key), vector.container().contains(key));
+}
+
+TEST(SortedVector, HeavyPayloadsSortIndirectly)
+{
+    static_assert(sorted_detail::heavy_entry<HeavyElem>);
+    HeavyVector vector{ShuffledHeavyElems(5000)};
+    EXPECT_EQ(vector.size(), 5000);
+    for (std::size_t i = 0; i < vector.size(); ++i)
+    {
+        EXPECT_EQ(vector.nth(i)->k, int(i));
+        EXPECT_EQ(vector.nth(i)->v.integers[0], int(i));
+    }
+    auto more = ShuffledHeavyElems(8000);
+    for (auto &elem : more)
+        elem.v.integers[0] = -elem.k;
+    vector.batch_insert(std::move(more));
+    EXPECT_EQ(vector.size(), 8000);
+    // existing keys keep their payload, the new ones bring theirs
+    EXPECT_EQ(vector.find(4999)->v.integers[0], 4999);
+    EXPECT_EQ(vector.find(5000)->v.integers[0], -5000);
+    EXPECT_EQ(vector.find(7999)->v.integers[0], -7999);
+}
+
+TEST(SortedVector, ApplyPermutation)
+{
+    std::vector<std::string> v{"a", "b", "c", "d", "e", "f"};
+    std::vector<std::size_t> perm{3, 0, 1, 2, 5, 4};
+    sorted_detail::apply_permutation(v, perm);
+    EXPECT_EQ(v, (std::vector<std::string>{"d", "a", "b", "c", "f", "e"}));
+    EXPECT_EQ(perm, (std::vector<std::size_t>{0, 1, 2, 3, 4, 5}));
+}
+
+TEST(SortedVector, RangeOps)
+{
+    auto vector = CreateVector(100);
+    const auto middle = vector.range(10, 20);
+    EXPECT_EQ(middle.size(), 10);
+    EXPECT_EQ(middle.begin()->k, 10);
+    EXPECT_EQ(vector.range(200, 300).size(), 0);
+    EXPECT_EQ(vector.erase_range(10, 20), 10);
+    EXPECT_EQ(vector.size(), 90);
+    EXPECT_FALSE(vector.contains(15));
+
+    // fits the gap: one tail move
+    std::vector<Elem> block{Elem{12, "12"}, Elem{13, "13"}, Elem{14, "14"}};
+    EXPECT_EQ(vector.insert_range(sorted_unique, block), 3);
+    // past the end
+    EXPECT_EQ(vector.insert_range(sorted_unique, {Elem{100, "100"}, Elem{101, "101"}}), 2);
+    // interleaved with existing keys, some already there: merged
+    EXPECT_EQ(vector.insert_range(sorted_unique, {Elem{9, "x"}, Elem{10, "10"}, Elem{15, "15"}, Elem{50, "x"}}), 2);
+    EXPECT_EQ(vector.size(), 97);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    EXPECT_EQ(vector.find(9)->v, "9");
+    EXPECT_EQ(vector.find(13)->v, "13");
+    EXPECT_EQ(vector.find(101)->v, "101");
+    EXPECT_EQ(vector.range(10, 20).size(), 5);
+}
+
+TEST(PackedMemoryArray, RandomChurn)
+{
+    MyPackedArray array;
+    MyMap model;
+    std::mt19937 rng(7);
+    for (int op = 0; op < 50000; ++op)
+    {
+        const int key = int(rng() % 5000);
+        if (rng() % 3 != 0)
+        {
+            EXPECT_EQ(array.insert(Elem{key, std::to_string(key)}), model.emplace(key, std::to_string(key)).second);
+        }
+        else
+        {
+            EXPECT_EQ(array.erase(key), model.erase(key));
+        }
+    }
+    ASSERT_EQ(array.size(), model.size());
+    EXPECT_TRUE(std::equal(array.begin(), array.end(), model.begin(), model.end(),
+                           [](const Elem &a, const MyMap::value_type &b) { return a.k == b.first && a.v == b.second; }));
+    for (int key = -1; key <= 5000; key += 13)
+    {
+        const auto found = array.lower_bound(key);
+        const auto expected = model.lower_bound(key);
+        EXPECT_EQ(found == array.end(), expected == model.end());
+        if (expected != model.end())
+        {
+            EXPECT_EQ(found->k, expected->first);
+        }
+    }
+    // empty it out, the array shrinks back down
+    for (int key = 0; key < 5000; ++key)
+        array.erase(key);
+    EXPECT_TRUE(array.empty());
+    EXPECT_EQ(array.begin(), array.end());
+    EXPECT_LE(array.capacity(), 128);
+}
+
+TEST(PackedMemoryArray, SparseAfterErase)
+{
+    // erase most of a big array in random order, lookups have to hold up at every density
+    MyPackedArray array{CreateVector(20000)};
+    MyMap model;
+    for (const auto &elem : array)
+        model.emplace(elem.k, elem.v);
+    const auto keys = ShuffledKeys(20000);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        EXPECT_EQ(array.erase(keys[i]), 1);
+        model.erase(keys[i]);
+        if (i % 2500 != 0 && i + 20 < keys.size())
+            continue;
+        ASSERT_EQ(array.size(), model.size());
+        EXPECT_TRUE(std::equal(array.begin(), array.end(), model.begin(), model.end(),
+                               [](const Elem &a, const MyMap::value_type &b) { return a.k == b.first; }));
+        for (int key = -1; key <= 20000; key += 97)
+        {
+            const auto found = array.lower_bound(key);
+            const auto expected = model.lower_bound(key);
+            ASSERT_EQ(found == array.end(), expected == model.end());
+            if (expected != model.end())
+            {
+                EXPECT_EQ(found->k, expected->first);
+            }
+        }
+    }
+    EXPECT_TRUE(array.empty());
+    EXPECT_LE(array.capacity(), 128);
+}
+
+TEST(PackedMemoryArray, FromVector)
+{
+    MyPackedArray array{CreateVector(1000)};
+    EXPECT_EQ(array.size(), 1000);
+    EXPECT_GE(array.capacity(), 2000);
+    EXPECT_EQ(array.find(500)->v, "0");
+    EXPECT_FALSE(array.insert(Elem{500, "x"}));
+    EXPECT_EQ(array.erase(500), 1);
+    EXPECT_EQ(array.lower_bound(500)->k, 501);
+    int expected = 0;
+    for (const auto &elem : array)
+    {
+        if (expected == 500)
+            ++expected;
+        EXPECT_EQ(elem.k, expected++);
+    }
+}
+
+TEST(InterleavedLookup, MatchesFind)
+{
+    auto vector = CreateVector(1000);
+    vector.batch_erase({3, 4, 60});
+    std::vector<int> queries{60, 999, 0, 3, 42, 1000, 42, -1, 5};
+    for (const int q : RandomSelection(1000, 500))
+        queries.push_back(q);
+    for (const std::size_t group : {1, 3, 16, 64})
+    {
+        const auto positions = interleaved::find(vector, std::span<const int>(queries), group);
+        ASSERT_EQ(positions.size(), queries.size());
+        for (std::size_t i = 0; i < queries.size(); ++i)
+            EXPECT_EQ(vector.nth(positions[i]), vector.find(queries[i])) << queries[i] << " group " << group;
+    }
+    const MyVector empty;
+    EXPECT_EQ(interleaved::find(empty, std::span<const int>(queries)), std::vector<std::size_t>(queries.size(), 0));
+}
+
+TEST(HugePageAllocator, AlignedAndUsable)
+{
+    // big enough for the huge page path
+    auto vector = CreateHugePageVector(1 << 17);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(&*vector.begin()) % huge_page_size, 0);
+    EXPECT_EQ(vector.size(), 1 << 17);
+    EXPECT_TRUE(std::is_sorted(vector.begin(), vector.end(), vector.value_comp()));
+    vector.batch_erase({5, 6, 7});
+    vector.batch_insert({Elem{-1, "x"}, Elem{6, "6"}});
+    EXPECT_EQ(vector.size(), (1 << 17) - 1);
+    EXPECT_EQ(vector.begin()->k, -1);
+    EXPECT_FALSE(vector.contains(5));
+    EXPECT_EQ(vector.find(6)->v, "6");
+    // and small ones come from the normal heap
+    const auto small = CreateHugePageVector(100);
+    EXPECT_TRUE(small.contains(99));
+    // sizes that would wrap round when counted in bytes are refused
+    huge_page_allocator<Elem> alloc;
+    EXPECT_THROW((void)alloc.allocate(alloc.max_size() + 1), std::bad_array_new_length);
+    EXPECT_THROW((void)alloc.allocate(std::numeric_limits<std::size_t>::max() / sizeof(Elem) + 2), std::bad_array_new_length);
+}
+
+TEST(CompressedColumns, CreateAndLookup)
+{
+    const auto columns = CreateCompressedColumns(10000);
+    EXPECT_EQ(columns.size(), 10000);
+    // 128 keys a block, 7 bit deltas, plus 16 bytes for the block and 4 for its minimum
+    EXPECT_LT(columns.key_bytes(), 10000 * sizeof(int) / 3);
+    for (int key = -1; key <= 10000; ++key)
+    {
+        const auto found = columns.find(key);
+        ASSERT_EQ(found != nullptr, key >= 0 && key < 10000) << key;
+        if (found)
+        {
+            EXPECT_EQ(*found, std::to_string(key % 100));
+        }
+    }
+    int expected = 0;
+    columns.for_each([&](int key, const std::string &value) {
+        EXPECT_EQ(key, expected++);
+        EXPECT_EQ(value, std::to_string(key % 100));
+    });
+    EXPECT_EQ(expected, 10000);
+
+    // sparse and negative keys, wider deltas
+    compressed_sorted_columns<std::int64_t, int> wide{{{-5, 0}, {INT64_MAX, 1}, {INT64_MIN, 2}, {1LL << 40, 3}, {0, 4}}};
+    EXPECT_EQ(*wide.find(INT64_MIN), 2);
+    EXPECT_EQ(*wide.find(INT64_MAX), 1);
+    EXPECT_EQ(*wide.find(1LL << 40), 3);
+    EXPECT_FALSE(wide.contains(1));
+}
+
+TEST(CompressedColumns, BatchInsertDelete)
+{
+    auto columns = CreateCompressedColumns(5000);
+    std::map<int, std::string> model;
+    for (int key = 0; key < 5000; ++key)
+        model.emplace(key, std::to_string(key % 100));
+    std::mt19937 rng(11);
+    for (int round = 0; round < 50; ++round)
+    {
+        std::vector<int> erase;
+        std::vector<Elem> insert;
+        for (int i = 0; i < 200; ++i)
+        {
+            erase.push_back(int(rng() % 8000));
+            const int key = int(rng() % 8000) - 1000;
+            insert.push_back(Elem{key, std::to_string(key)});
+        }
+        std::size_t erased = 0;
+        for (const int key : std::set<int>(erase.begin(), erase.end()))
+            erased += model.erase(key);
+        EXPECT_EQ(columns.batch_erase(erase), erased);
+        for (const auto &elem : insert)
+            model.emplace(elem.k, elem.v);
+        columns.batch_insert(insert);
+        ASSERT_EQ(columns.size(), model.size());
+    }
+    auto expected = model.begin();
+    columns.for_each([&](int key, const std::string &value) {
+        ASSERT_NE(expected, model.end());
+        EXPECT_EQ(key, expected->first);
+        EXPECT_EQ(value, expected->second);
+        ++expected;
+    });
+    EXPECT_EQ(expected, model.end());
+    // erased down to a few, the blocks are folded together
+    std::vector<int> all;
+    for (const auto &[key, value] : model)
+        all.push_back(key);
+    all.resize(all.size() - 10);
+    EXPECT_EQ(columns.batch_erase(all), all.size());
+    EXPECT_EQ(columns.size(), 10);
+    EXPECT_EQ(columns.block_count(), 1);
+}